@@ -4,13 +4,20 @@
 #include "movegenerator.h"
 #include "movelist.h"
 #include "search.h"
+#include "threadpool.h"
+#include "transposition.h"
+#include "zobrist.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace Gluon {
@@ -94,6 +101,179 @@ static const std::array<EvaluationPosition, NUM_EVALUATION_POSITIONS> EVALUATION
     { "Passed Pawn Race",     "8/1P4k1/8/8/8/8/6p1/1K6 w - - 0 60" }
 } };
 
+// [ Search benchmark ]
+
+// Long enough for the search to be well under way when the deadline passes.
+static constexpr int64_t STOP_LATENCY_MOVE_TIME_MILLISECONDS = 100;
+
+// [ Static exchange positions ]
+
+static constexpr size_t NUM_STATIC_EXCHANGE_POSITIONS = 10;
+
+struct StaticExchangePosition
+{
+    std::string fen;
+
+    std::string move;
+
+    // In the same piece values as the static exchange evaluation.
+    int expectedValue;
+};
+
+static const std::array<StaticExchangePosition, NUM_STATIC_EXCHANGE_POSITIONS> STATIC_EXCHANGE_POSITIONS = { {
+    { "4k3/8/8/3p4/4P3/8/8/4K3 w - - 0 1",                                  "e4d5",   100 },
+    { "4k3/8/2p5/3p4/4Q3/8/8/4K3 w - - 0 1",                                "e4d5",  -800 },
+    { "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1",                    "e1e5",   100 },
+    { "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1",           "d3e5",  -200 },
+    { "4R3/2r3p1/5bk1/1p1r3p/p2PR1P1/P1BK1P2/1P6/8 b - - 0 1",              "h5g4",     0 },
+    { "4r1k1/5pp1/nbp4p/1p2p2q/1P2P1b1/1BP2N1P/1B2QPPK/3R4 b - - 0 1",      "g4f3",     0 },
+    { "6rr/6pk/p1Qp1b1p/2n5/1B3p2/5p2/P1P2P2/4RK1R w - - 0 1",              "e1e8",  -500 },
+    { "3rk3/8/8/3r4/8/3R4/3R4/4K3 w - - 0 1",                               "d3d5",   500 },
+    { "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1",                                  "e5d6",   100 },
+    { "1n2k3/P7/8/8/8/8/8/4K3 w - - 0 1",                                   "a7b8q", 1100 }
+} };
+
+// [ Gives check test ]
+
+// Deep enough to reach the en passant captures, promotions and castling moves of every position.
+static constexpr int GIVES_CHECK_TEST_DEPTH = 4;
+
+// [ Move legality test ]
+
+// Every encoding is tried at every node, so this is kept shallow.
+static constexpr int MOVE_LEGALITY_TEST_DEPTH = 2;
+
+// [ Transposition table test ]
+
+static constexpr size_t TRANSPOSITION_TEST_THREAD_COUNT = 8;
+
+static constexpr size_t TRANSPOSITION_TEST_OPERATIONS_PER_THREAD = 2000000;
+
+// Few enough keys that the threads keep landing on the same buckets as each other.
+static constexpr size_t TRANSPOSITION_TEST_KEY_COUNT = 1U << 16;
+
+static constexpr size_t TRANSPOSITION_TEST_BUCKET_COUNT =
+    MIN_HASH_SIZE_MEGABYTES * BYTES_PER_MEGABYTE / sizeof(TranspositionBucket);
+
+// Random bits go only where the table looks, into the bucket index and the key fragment, so two
+// keys the table cannot tell apart are always the same key.
+static HashKey MakeTranspositionTestKey(HashKey& seed)
+{
+    const HashKey randomKey = Zobrist::NextRandomKey(seed) % TRANSPOSITION_TEST_KEY_COUNT;
+
+    const HashKey indexBits = randomKey % TRANSPOSITION_TEST_BUCKET_COUNT;
+    const HashKey fragmentBits = randomKey / TRANSPOSITION_TEST_BUCKET_COUNT;
+
+    return indexBits | (fragmentBits << KEY_FRAGMENT_SHIFT);
+}
+
+// The entry stored for a key is made from the key alone, so a probe can tell whether what it got
+// back really was stored for that key.
+static int GetTranspositionTestScore(HashKey key)
+{
+    return int(Zobrist::NextRandomKey(key) % 2001U) - 1000;
+}
+
+static Move GetTranspositionTestMove(HashKey key)
+{
+    const HashKey moveBits = Zobrist::NextRandomKey(key);
+
+    return Move(Square(moveBits % NUM_SQUARES), Square((moveBits >> 8) % NUM_SQUARES), Move::QUIET_MOVE);
+}
+
+static int GetTranspositionTestDepth(HashKey key)
+{
+    return 1 + int(key % HashKey(MAX_SEARCH_DEPTH - 1));
+}
+
+// Counts the moves, down to the given depth, that GivesCheck gets wrong.
+static size_t CountGivesCheckFailures(Position& position, int depth, size_t& checkingMoveCount)
+{
+    if (depth == 0)
+    {
+        return 0;
+    }
+
+    MoveList moves = GenerateLegalMoves(position);
+
+    size_t failureCount = 0;
+
+    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    {
+        const bool givesCheck = position.GivesCheck(moves[moveIndex]);
+
+        position.MakeMove(moves[moveIndex]);
+
+        checkingMoveCount += position.IsInCheck() ? 1U : 0U;
+        failureCount += givesCheck == position.IsInCheck() ? 0U : 1U;
+
+        failureCount += CountGivesCheckFailures(position, depth - 1, checkingMoveCount);
+
+        position.UnmakeMove(moves[moveIndex]);
+    }
+
+    return failureCount;
+}
+
+// Tells whether the move is in the list.
+static bool ContainsMove(const MoveList& moves, Move move)
+{
+    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    {
+        if (moves[moveIndex] == move)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Counts the nodes, down to the given depth, where a move encoding is judged differently by the
+// single move tests than by move generation.
+static size_t CountMoveLegalityFailures(Position& position, int depth)
+{
+    const MoveList pseudoLegalMoves = GeneratePseudoLegalMoves(position);
+    const MoveList legalMoves = GenerateLegalMoves(position);
+
+    size_t failureCount = 0;
+
+    for (size_t fromSquare = 0; fromSquare < NUM_SQUARES; ++fromSquare)
+    {
+        for (size_t toSquare = 0; toSquare < NUM_SQUARES; ++toSquare)
+        {
+            for (uint16_t moveFlag = Move::QUIET_MOVE; moveFlag <= Move::QUEEN_PROMOTION_CAPTURE; ++moveFlag)
+            {
+                const Move move{ Square(fromSquare), Square(toSquare), Move::MoveFlag(moveFlag) };
+
+                const bool isPseudoLegal = position.IsPseudoLegal(move);
+
+                if (isPseudoLegal != ContainsMove(pseudoLegalMoves, move) ||
+                    (isPseudoLegal && position.IsLegal(move)) != ContainsMove(legalMoves, move))
+                {
+                    ++failureCount;
+                }
+            }
+        }
+    }
+
+    if (depth <= 1)
+    {
+        return failureCount;
+    }
+
+    for (size_t moveIndex = 0; moveIndex < legalMoves.Size(); ++moveIndex)
+    {
+        position.MakeMove(legalMoves[moveIndex]);
+
+        failureCount += CountMoveLegalityFailures(position, depth - 1);
+
+        position.UnmakeMove(legalMoves[moveIndex]);
+    }
+
+    return failureCount;
+}
+
 static char SwapPieceCharColour(char pieceChar)
 {
     if (pieceChar >= 'a' && pieceChar <= 'z')
@@ -179,24 +359,23 @@ uint64_t Perft(Position& position, int depth)
         return 1;
     }
 
-    MoveList moves = GenerateLegalMoves(position);
-
+    // The leaves are counted rather than generated.
     if (depth == 1)
     {
-        return moves.Size();
+        return CountLegalMoves(position);
     }
 
+    MoveList moves = GenerateLegalMoves(position);
+
     uint64_t nodes = 0;
 
     for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
     {
-        PositionState state;
-
-        position.MakeMove(moves[moveIndex], state);
+        position.MakeMove(moves[moveIndex]);
 
         nodes += Perft(position, depth - 1);
 
-        position.UnmakeMove(moves[moveIndex], state);
+        position.UnmakeMove(moves[moveIndex]);
     }
 
     return nodes;
@@ -306,6 +485,184 @@ size_t RunEvaluationTest()
     return failureCount;
 }
 
+size_t RunStaticExchangeTest()
+{
+    static const std::string rowSpacing = std::string(30, '-');
+
+    size_t failureCount = 0;
+
+    std::cout << std::left  << std::setw(10) << "Move"
+              << std::right << std::setw(10) << "Expected"
+                            << std::setw(10) << "Result" << '\n'
+              << rowSpacing << '\n';
+
+    for (const StaticExchangePosition& staticExchangePosition : STATIC_EXCHANGE_POSITIONS)
+    {
+        Position position;
+        position.SetupWithFEN(staticExchangePosition.fen);
+
+        const Move move = ParseLegalMove(position, staticExchangePosition.move);
+
+        // The evaluation only answers whether a threshold is reached, so the value is the highest
+        // threshold that is, and must be exactly the expected one.
+        const bool passed = !move.IsNull() && position.SEE(move, staticExchangePosition.expectedValue) &&
+                            !position.SEE(move, staticExchangePosition.expectedValue + 1);
+
+        failureCount += passed ? 0 : 1;
+
+        std::cout << std::left  << std::setw(10) << staticExchangePosition.move
+                  << std::right << std::setw(10) << staticExchangePosition.expectedValue
+                                << std::setw(10) << (passed ? "PASS" : "FAIL") << '\n';
+    }
+
+    std::cout << rowSpacing << '\n'
+              << "Total: " << failureCount << " failure(s)\n";
+
+    return failureCount;
+}
+
+size_t RunGivesCheckTest()
+{
+    static const std::string rowSpacing = std::string(53, '-');
+
+    size_t failureCount = 0;
+
+    std::cout << std::left  << std::setw(23) << "Position"
+              << std::right << std::setw(6)  << "Depth"
+                            << std::setw(14) << "Checks"
+                            << std::setw(10) << "Result" << '\n'
+              << rowSpacing << '\n';
+
+    for (const BenchmarkPosition& benchmarkPosition : BENCHMARK_POSITIONS)
+    {
+        Position position;
+        position.SetupWithFEN(benchmarkPosition.fen);
+
+        size_t checkingMoveCount = 0;
+
+        const size_t positionFailureCount = CountGivesCheckFailures(position, GIVES_CHECK_TEST_DEPTH,
+                                                                    checkingMoveCount);
+
+        failureCount += positionFailureCount;
+
+        std::cout << std::left  << std::setw(23) << benchmarkPosition.name
+                  << std::right << std::setw(6)  << GIVES_CHECK_TEST_DEPTH
+                                << std::setw(14) << checkingMoveCount
+                                << std::setw(10) << (positionFailureCount == 0 ? "PASS" : "FAIL") << '\n';
+    }
+
+    std::cout << rowSpacing << '\n'
+              << "Total: " << failureCount << " failure(s)\n";
+
+    return failureCount;
+}
+
+size_t RunMoveLegalityTest()
+{
+    static const std::string rowSpacing = std::string(39, '-');
+
+    size_t failureCount = 0;
+
+    std::cout << std::left  << std::setw(23) << "Position"
+              << std::right << std::setw(6)  << "Depth"
+                            << std::setw(10) << "Result" << '\n'
+              << rowSpacing << '\n';
+
+    for (const BenchmarkPosition& benchmarkPosition : BENCHMARK_POSITIONS)
+    {
+        Position position;
+        position.SetupWithFEN(benchmarkPosition.fen);
+
+        const size_t positionFailureCount = CountMoveLegalityFailures(position, MOVE_LEGALITY_TEST_DEPTH);
+
+        failureCount += positionFailureCount;
+
+        std::cout << std::left  << std::setw(23) << benchmarkPosition.name
+                  << std::right << std::setw(6)  << MOVE_LEGALITY_TEST_DEPTH
+                                << std::setw(10) << (positionFailureCount == 0 ? "PASS" : "FAIL") << '\n';
+    }
+
+    std::cout << rowSpacing << '\n'
+              << "Total: " << failureCount << " failure(s)\n";
+
+    return failureCount;
+}
+
+size_t RunTranspositionTableTest()
+{
+    static_assert(std::has_single_bit(TRANSPOSITION_TEST_BUCKET_COUNT));
+
+    TranspositionTable transpositionTable;
+    transpositionTable.Resize(MIN_HASH_SIZE_MEGABYTES);
+
+    std::atomic<size_t> hitCount = 0;
+    std::atomic<size_t> failureCount = 0;
+
+    std::vector<std::thread> testThreads;
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t threadIndex = 0; threadIndex < TRANSPOSITION_TEST_THREAD_COUNT; ++threadIndex)
+    {
+        testThreads.emplace_back([&transpositionTable, &hitCount, &failureCount, threadIndex]()
+        {
+            HashKey seed = Zobrist::RANDOM_SEED + threadIndex;
+
+            size_t threadHitCount = 0;
+            size_t threadFailureCount = 0;
+
+            for (size_t operation = 0; operation < TRANSPOSITION_TEST_OPERATIONS_PER_THREAD; ++operation)
+            {
+                const HashKey key = MakeTranspositionTestKey(seed);
+
+                // Every other operation is a store, so reads and writes of a bucket overlap.
+                if (operation % 2 == 0)
+                {
+                    transpositionTable.Store(key, GetTranspositionTestDepth(key), 0,
+                                             GetTranspositionTestScore(key), EXACT_BOUND,
+                                             GetTranspositionTestMove(key));
+
+                    continue;
+                }
+
+                int score = 0;
+                Move hashMove;
+
+                if (!transpositionTable.Probe(key, 0, 0, -INFINITE_SCORE, INFINITE_SCORE, score, hashMove))
+                {
+                    continue;
+                }
+
+                ++threadHitCount;
+
+                if (score != GetTranspositionTestScore(key) || !(hashMove == GetTranspositionTestMove(key)))
+                {
+                    ++threadFailureCount;
+                }
+            }
+
+            hitCount += threadHitCount;
+            failureCount += threadFailureCount;
+        });
+    }
+
+    for (std::thread& testThread : testThreads)
+    {
+        testThread.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - startTime).count();
+
+    std::cout << "Threads: " << TRANSPOSITION_TEST_THREAD_COUNT
+              << ", operations: " << TRANSPOSITION_TEST_THREAD_COUNT * TRANSPOSITION_TEST_OPERATIONS_PER_THREAD
+              << ", hits: " << hitCount
+              << ", time: " << std::fixed << std::setprecision(3) << seconds << "s\n"
+              << "Total: " << failureCount << " failure(s)\n";
+
+    return failureCount;
+}
+
 void RunSearchBenchmark(int depth)
 {
     static const std::string rowSpacing = std::string(80, '-');
@@ -329,10 +686,10 @@ void RunSearchBenchmark(int depth)
         Position position;
         position.SetupWithFEN(evaluationPosition.fen);
 
-        Searcher searcher;
+        ThreadPool threadPool;
 
         const auto startTime = std::chrono::steady_clock::now();
-        const SearchResult result = searcher.Run(position, limits);
+        const SearchResult result = threadPool.Run(position, limits);
         const double seconds = std::chrono::duration<double>(
                                    std::chrono::steady_clock::now() - startTime).count();
 
@@ -353,6 +710,35 @@ void RunSearchBenchmark(int depth)
               << std::fixed << std::setprecision(3) << totalSeconds << "s ("
               << std::setprecision(0)
               << (totalSeconds > 0.0 ? double(totalNodes) / totalSeconds : 0.0) << " nodes/s)\n";
+
+    // How long past its move time each search takes to hand back a move.
+    SearchLimits moveTimeLimits;
+    moveTimeLimits.moveTimeMilliseconds = STOP_LATENCY_MOVE_TIME_MILLISECONDS;
+
+    double totalStopLatencyMilliseconds = 0.0;
+    double maxStopLatencyMilliseconds = 0.0;
+
+    for (const EvaluationPosition& evaluationPosition : EVALUATION_POSITIONS)
+    {
+        Position position;
+        position.SetupWithFEN(evaluationPosition.fen);
+
+        ThreadPool threadPool;
+
+        const auto startTime = std::chrono::steady_clock::now();
+        threadPool.Run(position, moveTimeLimits);
+        const double stopLatencyMilliseconds = std::chrono::duration<double, std::milli>(
+                                                   std::chrono::steady_clock::now() - startTime).count() -
+                                               double(STOP_LATENCY_MOVE_TIME_MILLISECONDS);
+
+        totalStopLatencyMilliseconds += stopLatencyMilliseconds;
+        maxStopLatencyMilliseconds = std::max(maxStopLatencyMilliseconds, stopLatencyMilliseconds);
+    }
+
+    std::cout << "Stop latency: " << std::setprecision(3)
+              << totalStopLatencyMilliseconds / double(EVALUATION_POSITIONS.size()) << "ms average, "
+              << maxStopLatencyMilliseconds << "ms max over " << STOP_LATENCY_MOVE_TIME_MILLISECONDS
+              << "ms searches\n";
 }
 
 } // namespace Gluon
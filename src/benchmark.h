@@ -18,6 +18,21 @@ size_t RunBenchmark(int maxDepth = DEFAULT_BENCHMARK_DEPTH);
 // Scores every evaluation position and returns the number whose score does not survive a mirror.
 size_t RunEvaluationTest();
 
+// Stores and probes the transposition table from several threads at once and returns the number
+// of probes that gave back an entry that was never stored for that key.
+size_t RunTranspositionTableTest();
+
+// Checks the static exchange evaluation of known exchanges and returns the number it gets wrong.
+size_t RunStaticExchangeTest();
+
+// Walks the perft positions to a fixed depth, checking that every move gives check exactly when
+// making it leaves the other side in check, and returns the number of moves where it does not.
+size_t RunGivesCheckTest();
+
+// Walks the perft positions to a fixed depth, checking every possible move encoding against the
+// generated moves, and returns the number of positions where a move is judged wrongly.
+size_t RunMoveLegalityTest();
+
 // Searches every evaluation position to a fixed depth and reports nodes and speed.
 void RunSearchBenchmark(int depth = DEFAULT_SEARCH_BENCHMARK_DEPTH);
 
@@ -4,10 +4,13 @@
 #include "movelist.h"
 #include "uci.h"
 
+#include <algorithm>
+
 namespace Gluon {
 
 // [ Constructors ]
 Engine::Engine()
+    : multiPV(DEFAULT_MULTI_PV)
 {
     NewGame();
 }
@@ -30,6 +33,8 @@ void Engine::NewGame()
     SetPosition(START_POSITION_FEN);
 
     ClearHash();
+
+    threadPool.ClearHeuristics();
 }
 
 void Engine::SetPosition(const std::string& fen)
@@ -39,18 +44,11 @@ void Engine::SetPosition(const std::string& fen)
 
 void Engine::PlayMove(const std::string& moveString)
 {
-    const MoveList moves = GenerateLegalMoves(position);
+    const Move move = ParseLegalMove(position, moveString);
 
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    if (!move.IsNull())
     {
-        if (moves[moveIndex].ToString() == moveString)
-        {
-            PositionState state;
-
-            position.MakeMove(moves[moveIndex], state);
-
-            return;
-        }
+        position.MakeMove(move);
     }
 }
 
@@ -58,44 +56,53 @@ void Engine::StartSearch(const SearchLimits& limits)
 {
     StopSearch();
 
-    searchThread = std::thread(&Engine::RunSearch, this, position, limits);
+    SearchLimits searchLimits = limits;
+    searchLimits.multiPV = multiPV;
+
+    threadPool.StartSearch(position, searchLimits, UCI::PrintSearchInfo, UCI::PrintBestMove);
 }
 
 void Engine::StopSearch()
 {
-    searcher.RequestStop();
+    threadPool.RequestStop();
 
     WaitForSearch();
 }
 
+void Engine::PonderHit()
+{
+    threadPool.PonderHit();
+}
+
 void Engine::WaitForSearch()
 {
-    if (searchThread.joinable())
-    {
-        searchThread.join();
-    }
+    threadPool.WaitForSearch();
 }
 
 void Engine::SetHashSize(size_t megabytes)
 {
     StopSearch();
 
-    searcher.ResizeTranspositionTable(megabytes);
+    threadPool.ResizeTranspositionTable(megabytes);
 }
 
-void Engine::ClearHash()
+void Engine::SetThreadCount(size_t threadCount)
 {
     StopSearch();
 
-    searcher.ClearTranspositionTable();
+    threadPool.SetThreadCount(threadCount);
+}
+
+void Engine::SetMultiPV(size_t lineCount)
+{
+    multiPV = std::clamp(lineCount, MIN_MULTI_PV, MAX_MULTI_PV);
 }
 
-// [ Private methods ]
-void Engine::RunSearch(Position searchPosition, SearchLimits limits)
+void Engine::ClearHash()
 {
-    const SearchResult result = searcher.Run(searchPosition, limits, UCI::PrintSearchInfo);
+    StopSearch();
 
-    UCI::PrintBestMove(result);
+    threadPool.ClearTranspositionTable();
 }
 
 } // namespace Gluon
@@ -2,9 +2,9 @@
 
 #include "position.h"
 #include "search.h"
+#include "threadpool.h"
 
 #include <string>
-#include <thread>
 
 namespace Gluon {
 
@@ -34,15 +34,22 @@ public:
 
     void PlayMove(const std::string& moveString);
 
-    // Searches a copy of the current position on its own thread, so commands can still be read.
+    // Searches a copy of the current position on the thread pool, so commands can still be read.
     void StartSearch(const SearchLimits& limits);
 
     void StopSearch();
 
+    // The opponent played the move being pondered on, so the search carries on under its time limits.
+    void PonderHit();
+
     void WaitForSearch();
 
     void SetHashSize(size_t megabytes);
 
+    void SetThreadCount(size_t threadCount);
+
+    void SetMultiPV(size_t lineCount);
+
     void ClearHash();
 
     inline const Position& GetPosition() const
@@ -51,15 +58,12 @@ public:
     }
 
 private:
-    // [ Private methods ]
-    void RunSearch(Position searchPosition, SearchLimits limits);
-
     // [ Data members ]
     Position position;
 
-    Searcher searcher;
+    ThreadPool threadPool;
 
-    std::thread searchThread;
+    size_t multiPV;
 };
 
 } // namespace Gluon
@@ -23,21 +23,6 @@ enum Phase : uint8_t
 
 constexpr int MAX_PHASE = 24;
 
-// [ Piece indexing ]
-constexpr size_t PieceTypeToIndex(PieceType pieceType)
-{
-    switch (pieceType)
-    {
-        case PAWN:   return 0;
-        case KNIGHT: return 1;
-        case BISHOP: return 2;
-        case ROOK:   return 3;
-        case QUEEN:  return 4;
-        case KING:   return 5;
-        default:     return 0;
-    }
-}
-
 constexpr bool IsMateScore(int score)
 {
     return score >= MATE_SCORE - MAX_MATE_PLIES || score <= -MATE_SCORE + MAX_MATE_PLIES;
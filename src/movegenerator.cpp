@@ -9,7 +9,8 @@
 
 namespace Gluon {
 
-static void GeneratePawnMoves(const Position& position, MoveList& moveList, bool capturesOnly)
+static void GeneratePawnMoves(const Position& position, MoveList& moveList,
+                              MoveGenerationType generationType)
 {
     Colour activeColour = position.GetActiveColour();
     Bitboard friendlyPawnBitboard = position.GetPieceBitboard(activeColour == WHITE ?
@@ -56,7 +57,7 @@ static void GeneratePawnMoves(const Position& position, MoveList& moveList, bool
     eastCapturesBitboard  &= ~promotionRankBitboard;
     westCapturesBitboard  &= ~promotionRankBitboard;
 
-    if (!capturesOnly)
+    if (generationType != CAPTURE_MOVES)
     {
         // Pushes
         while (pushesBitboard)
@@ -75,6 +76,11 @@ static void GeneratePawnMoves(const Position& position, MoveList& moveList, bool
         }
     }
 
+    if (generationType == QUIET_MOVES)
+    {
+        return;
+    }
+
     // Captures
     while (eastCapturesBitboard)
     {
@@ -159,34 +165,35 @@ static Bitboard GetPieceAttacks(PieceType pieceType, Square square, Bitboard occ
     }
 }
 
-static void GeneratePieceMoves(const Position& position, MoveList& moveList, bool capturesOnly)
+static void GeneratePieceMoves(const Position& position, MoveList& moveList, PieceType pieceType,
+                               MoveGenerationType generationType)
 {
     Colour activeColour = position.GetActiveColour();
 
-    for (PieceType pieceType : PIECE_MOVE_PIECE_TYPES)
-    {
-        Bitboard friendlyPieceBitboard = position.GetPieceBitboard(MakePiece(activeColour, pieceType));
+    Bitboard friendlyPieceBitboard = position.GetPieceBitboard(MakePiece(activeColour, pieceType));
 
-        while (friendlyPieceBitboard)
-        {
-            Square fromSquare = Square(BB::PopLSB(friendlyPieceBitboard));
-            Bitboard pieceMoveBitboard = GetPieceAttacks(pieceType, fromSquare,
-                                                         position.GetAllOccupancyBitboard());
+    while (friendlyPieceBitboard)
+    {
+        Square fromSquare = Square(BB::PopLSB(friendlyPieceBitboard));
+        Bitboard pieceMoveBitboard = GetPieceAttacks(pieceType, fromSquare,
+                                                     position.GetAllOccupancyBitboard());
 
-            Bitboard quietMovesBitboard = pieceMoveBitboard & (~position.GetAllOccupancyBitboard());
-            Bitboard capturesBitboard = pieceMoveBitboard & (position.GetOccupancyBitboard(~activeColour));
+        Bitboard quietMovesBitboard = pieceMoveBitboard & (~position.GetAllOccupancyBitboard());
+        Bitboard capturesBitboard = pieceMoveBitboard & (position.GetOccupancyBitboard(~activeColour));
 
-            if (!capturesOnly)
+        if (generationType != CAPTURE_MOVES)
+        {
+            // Quiet moves
+            while (quietMovesBitboard)
             {
-                // Quiet moves
-                while (quietMovesBitboard)
-                {
-                    Square toSquare = Square(BB::PopLSB(quietMovesBitboard));
+                Square toSquare = Square(BB::PopLSB(quietMovesBitboard));
 
-                    moveList.AddMove(Move(fromSquare, toSquare, Move::QUIET_MOVE));
-                }
+                moveList.AddMove(Move(fromSquare, toSquare, Move::QUIET_MOVE));
             }
+        }
 
+        if (generationType != QUIET_MOVES)
+        {
             // Captures
             while (capturesBitboard)
             {
@@ -198,7 +205,34 @@ static void GeneratePieceMoves(const Position& position, MoveList& moveList, boo
     }
 }
 
-static void GenerateKingMoves(const Position& position, MoveList& moveList, bool capturesOnly)
+// The castling move on the given side if the right to it remains and the path is clear, or a null
+// move otherwise. Whether the king passes through check is left to the legality test.
+static Move GetCastlingMove(const Position& position, Square kingSquare, Move::MoveFlag castlingFlag)
+{
+    Colour activeColour = position.GetActiveColour();
+    bool isKingSide = castlingFlag == Move::KING_CASTLE;
+
+    CastlingRight castlingRight = isKingSide ? (activeColour == WHITE ? WHITE_OO  : BLACK_OO)
+                                             : (activeColour == WHITE ? WHITE_OOO : BLACK_OOO);
+
+    Bitboard pathBitboard = isKingSide ? (activeColour == WHITE ? MoveTables::WHITE_KING_SIDE_CASTLING_PATH
+                                                                : MoveTables::BLACK_KING_SIDE_CASTLING_PATH)
+                                       : (activeColour == WHITE ? MoveTables::WHITE_QUEEN_SIDE_CASTLING_PATH
+                                                                : MoveTables::BLACK_QUEEN_SIDE_CASTLING_PATH);
+
+    if (!(position.GetCastlingRights() & castlingRight) || (pathBitboard & position.GetAllOccupancyBitboard()))
+    {
+        return Move();
+    }
+
+    Square toSquare = isKingSide ? (activeColour == WHITE ? SQUARE_G1 : SQUARE_G8)
+                                 : (activeColour == WHITE ? SQUARE_C1 : SQUARE_C8);
+
+    return Move(kingSquare, toSquare, castlingFlag);
+}
+
+static void GenerateKingMoves(const Position& position, MoveList& moveList,
+                              MoveGenerationType generationType)
 {
     Colour activeColour = position.GetActiveColour();
     Bitboard friendlyKingBitboard = position.GetPieceBitboard(activeColour == WHITE ?
@@ -210,7 +244,7 @@ static void GenerateKingMoves(const Position& position, MoveList& moveList, bool
     Bitboard quietMovesBitboard = kingMoveBitboard & (~position.GetAllOccupancyBitboard());
     Bitboard capturesBitboard = kingMoveBitboard & (position.GetOccupancyBitboard(~activeColour));
 
-    if (!capturesOnly)
+    if (generationType != CAPTURE_MOVES)
     {
         // Quiet moves
         while (quietMovesBitboard)
@@ -221,193 +255,364 @@ static void GenerateKingMoves(const Position& position, MoveList& moveList, bool
         }
     }
 
-    // Captures
-    while (capturesBitboard)
+    if (generationType != QUIET_MOVES)
     {
-        Square toSquare = Square(BB::PopLSB(capturesBitboard));
+        // Captures
+        while (capturesBitboard)
+        {
+            Square toSquare = Square(BB::PopLSB(capturesBitboard));
 
-        moveList.AddMove(Move(fromSquare, toSquare, Move::CAPTURE));
+            moveList.AddMove(Move(fromSquare, toSquare, Move::CAPTURE));
+        }
     }
 
-    if (capturesOnly)
+    if (generationType == CAPTURE_MOVES)
     {
         return;
     }
 
     // Castling
-    CastlingRight kingSideCastlingRight  = activeColour == WHITE ? WHITE_OO  : BLACK_OO;
-    CastlingRight queenSideCastlingRight = activeColour == WHITE ? WHITE_OOO : BLACK_OOO;
+    for (Move::MoveFlag castlingFlag : { Move::KING_CASTLE, Move::QUEEN_CASTLE })
+    {
+        Move castlingMove = GetCastlingMove(position, fromSquare, castlingFlag);
+
+        if (!castlingMove.IsNull())
+        {
+            moveList.AddMove(castlingMove);
+        }
+    }
+}
+
+// What a pseudo-legal move has to respect so as not to leave its own king in check.
+struct KingSafety
+{
+    Square kingSquare;
 
-    Bitboard kingSidePathBitboard  = activeColour == WHITE ? MoveTables::WHITE_KING_SIDE_CASTLING_PATH :
-                                                             MoveTables::BLACK_KING_SIDE_CASTLING_PATH;
-    Bitboard queenSidePathBitboard = activeColour == WHITE ? MoveTables::WHITE_QUEEN_SIDE_CASTLING_PATH :
-                                                             MoveTables::BLACK_QUEEN_SIDE_CASTLING_PATH;
+    Bitboard checkersBitboard;
 
-    Square kingSideToSquare  = activeColour == WHITE ? SQUARE_G1 : SQUARE_G8;
-    Square queenSideToSquare = activeColour == WHITE ? SQUARE_C1 : SQUARE_C8;
+    // Squares a non-king move must land on to deal with a check, which is every square when there
+    // is no check and no square when there is more than one checker.
+    Bitboard checkMaskBitboard;
 
-    if ((position.GetCastlingRights() & kingSideCastlingRight) &&
-        !(kingSidePathBitboard & position.GetAllOccupancyBitboard()))
+    Bitboard pinnedBitboard;
+};
+
+// Read from what the position worked out when the last move was made.
+static KingSafety GetKingSafety(const Position& position)
+{
+    KingSafety kingSafety;
+
+    Colour activeColour = position.GetActiveColour();
+
+    kingSafety.kingSquare = position.GetKingSquare(activeColour);
+    kingSafety.checkersBitboard = position.GetCheckersBitboard();
+
+    // !EXPLAIN!
+    kingSafety.checkMaskBitboard = ~0ULL;
+    if (BB::CountBits(kingSafety.checkersBitboard) > 1)
     {
-        moveList.AddMove(Move(fromSquare, kingSideToSquare, Move::KING_CASTLE));
+        kingSafety.checkMaskBitboard = 0ULL;
     }
-
-    if ((position.GetCastlingRights() & queenSideCastlingRight) &&
-        !(queenSidePathBitboard & position.GetAllOccupancyBitboard()))
+    else if (kingSafety.checkersBitboard)
     {
-        moveList.AddMove(Move(fromSquare, queenSideToSquare, Move::QUEEN_CASTLE));
+        Square checkerSquare = Square(BB::GetLSB(kingSafety.checkersBitboard));
+
+        kingSafety.checkMaskBitboard = MoveTables::BETWEEN_TABLE[kingSafety.kingSquare][checkerSquare] |
+                                       kingSafety.checkersBitboard;
     }
+
+    kingSafety.pinnedBitboard = position.GetBlockersForKingBitboard(activeColour) &
+                                position.GetOccupancyBitboard(activeColour);
+
+    return kingSafety;
 }
 
-// !EXPLAIN!
-static Bitboard GetAttackersToSquare(const Position& position, Square square, Colour attackerColour,
-                                     Bitboard occupancyBitboard)
+// Tells whether a pseudo-legal move leaves its own king safe.
+static bool IsKingSafeAfterMove(const Position& position, const KingSafety& kingSafety, Move move)
 {
-    Bitboard pawnBitboard   = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_PAWN   : BLACK_PAWN);
-    Bitboard knightBitboard = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_KNIGHT : BLACK_KNIGHT);
-    Bitboard bishopBitboard = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_BISHOP : BLACK_BISHOP);
-    Bitboard rookBitboard   = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_ROOK   : BLACK_ROOK);
-    Bitboard queenBitboard  = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_QUEEN  : BLACK_QUEEN);
-    Bitboard kingBitboard   = position.GetPieceBitboard(attackerColour == WHITE ? WHITE_KING   : BLACK_KING);
-
-    return (MoveTables::PAWN_ATTACK_TABLE[~attackerColour][square] & pawnBitboard)                       |
-           (MoveTables::KNIGHT_MOVE_TABLE[square] & knightBitboard)                                      |
-           (MoveTables::KING_MOVE_TABLE[square] & kingBitboard)                                          |
-           (MoveTables::GetBishopMoves(square, occupancyBitboard) & (bishopBitboard | queenBitboard))    |
-           (MoveTables::GetRookMoves(square, occupancyBitboard) & (rookBitboard | queenBitboard));
+    Colour enemyColour = ~position.GetActiveColour();
+
+    Bitboard allOccupancyBitboard = position.GetAllOccupancyBitboard();
+
+    Square kingSquare = kingSafety.kingSquare;
+    Square fromSquare = move.GetFromSquare();
+    Square toSquare = move.GetToSquare();
+
+    // King moves
+    if (fromSquare == kingSquare)
+    {
+        if (move.GetFlag() == Move::KING_CASTLE || move.GetFlag() == Move::QUEEN_CASTLE)
+        {
+            Square transitSquare = move.GetFlag() == Move::KING_CASTLE ? fromSquare + EAST
+                                                                       : fromSquare + WEST;
+
+            return !kingSafety.checkersBitboard &&
+                   !position.GetAttackersToSquare(transitSquare, enemyColour, allOccupancyBitboard) &&
+                   !position.GetAttackersToSquare(toSquare, enemyColour, allOccupancyBitboard);
+        }
+
+        // !EXPLAIN!
+        return !position.GetAttackersToSquare(toSquare, enemyColour,
+                                              allOccupancyBitboard ^ SquareToBitboard(kingSquare));
+    }
+
+    // !EXPLAIN!
+    if (move.GetFlag() == Move::EN_PASSANT_CAPTURE)
+    {
+        Direction pushDirection = position.GetActiveColour() == WHITE ? NORTH : SOUTH;
+
+        Bitboard capturedPawnBitboard = SquareToBitboard(toSquare - pushDirection);
+        Bitboard occupancyBitboard = (allOccupancyBitboard ^ SquareToBitboard(fromSquare) ^
+                                      capturedPawnBitboard) | SquareToBitboard(toSquare);
+
+        return !(position.GetAttackersToSquare(kingSquare, enemyColour, occupancyBitboard) &
+                 (~capturedPawnBitboard));
+    }
+
+    // Pinned and checked pieces
+    if (!(kingSafety.checkMaskBitboard & SquareToBitboard(toSquare)))
+    {
+        return false;
+    }
+
+    return !(kingSafety.pinnedBitboard & SquareToBitboard(fromSquare)) ||
+           (MoveTables::LINE_TABLE[kingSquare][fromSquare] & SquareToBitboard(toSquare));
 }
 
-MoveList GeneratePseudoLegalMoves(const Position& position, bool capturesOnly)
+MoveList GeneratePseudoLegalMoves(const Position& position, MoveGenerationType generationType)
 {
     MoveList moves;
 
-    GeneratePawnMoves(position, moves, capturesOnly);
-    GeneratePieceMoves(position, moves, capturesOnly);
-    GenerateKingMoves(position, moves, capturesOnly);
+    GeneratePawnMoves(position, moves, generationType);
+
+    for (PieceType pieceType : PIECE_MOVE_PIECE_TYPES)
+    {
+        GeneratePieceMoves(position, moves, pieceType, generationType);
+    }
+
+    GenerateKingMoves(position, moves, generationType);
 
     return moves;
 }
 
-MoveList GenerateLegalMoves(const Position& position, bool capturesOnly)
+MoveList GenerateLegalMoves(const Position& position, MoveGenerationType generationType)
 {
-    MoveList pseudoLegalMoves = GeneratePseudoLegalMoves(position, capturesOnly);
     MoveList legalMoves;
 
-    Colour activeColour = position.GetActiveColour();
-    Colour enemyColour = ~activeColour;
+    GenerateLegalMoves(position, legalMoves, generationType);
 
-    Bitboard allOccupancyBitboard = position.GetAllOccupancyBitboard();
-    Bitboard friendlyOccupancyBitboard = position.GetOccupancyBitboard(activeColour);
-    Bitboard enemyOccupancyBitboard = position.GetOccupancyBitboard(enemyColour);
+    return legalMoves;
+}
 
-    Bitboard friendlyKingBitboard = position.GetPieceBitboard(activeColour == WHITE ?
-                                                              WHITE_KING : BLACK_KING);
-    Square kingSquare = Square(BB::GetLSB(friendlyKingBitboard));
+void GenerateLegalMoves(const Position& position, MoveList& moveList, MoveGenerationType generationType)
+{
+    MoveList pseudoLegalMoves = GeneratePseudoLegalMoves(position, generationType);
 
-    Direction pushDirection = activeColour == WHITE ? NORTH : SOUTH;
+    KingSafety kingSafety = GetKingSafety(position);
 
-    Bitboard checkersBitboard = GetAttackersToSquare(position, kingSquare, enemyColour,
-                                                     allOccupancyBitboard);
+    for (size_t moveIndex = 0; moveIndex < pseudoLegalMoves.Size(); ++moveIndex)
+    {
+        if (IsKingSafeAfterMove(position, kingSafety, pseudoLegalMoves[moveIndex]))
+        {
+            moveList.AddMove(pseudoLegalMoves[moveIndex]);
+        }
+    }
+}
 
-    // !EXPLAIN!
-    Bitboard checkMaskBitboard = ~0ULL;
-    if (BB::CountBits(checkersBitboard) > 1)
+// The squares the king can step to without being attacked there. Castling is left out.
+static Bitboard GetSafeKingTargets(const Position& position, const KingSafety& kingSafety)
+{
+    Colour enemyColour = ~position.GetActiveColour();
+
+    Bitboard targetsBitboard = MoveTables::KING_MOVE_TABLE[kingSafety.kingSquare] &
+                               (~position.GetOccupancyBitboard(position.GetActiveColour()));
+    Bitboard occupancyBitboard = position.GetAllOccupancyBitboard() ^ SquareToBitboard(kingSafety.kingSquare);
+
+    Bitboard safeTargetsBitboard = 0ULL;
+    while (targetsBitboard)
     {
-        checkMaskBitboard = 0ULL;
+        Square toSquare = Square(BB::PopLSB(targetsBitboard));
+
+        if (!position.GetAttackersToSquare(toSquare, enemyColour, occupancyBitboard))
+        {
+            BB::SetSquare(safeTargetsBitboard, toSquare);
+        }
     }
-    else if (checkersBitboard)
+
+    return safeTargetsBitboard;
+}
+
+// The squares a pawn or piece other than the king can legally move to, en passant aside. Each
+// target on the last rank stands for all four promotions.
+static Bitboard GetLegalTargets(const Position& position, const KingSafety& kingSafety,
+                                PieceType pieceType, Square fromSquare)
+{
+    Colour activeColour = position.GetActiveColour();
+
+    Bitboard targetsBitboard = 0ULL;
+
+    if (pieceType == PAWN)
     {
-        Square checkerSquare = Square(BB::GetLSB(checkersBitboard));
+        Direction pushDirection = activeColour == WHITE ? NORTH : SOUTH;
+        Bitboard doublePushRankBitboard = RankToBitboard(activeColour == WHITE ? RANK_4 : RANK_5);
+        Bitboard emptyBitboard = ~position.GetAllOccupancyBitboard();
+
+        Bitboard pushBitboard = BB::Shift(SquareToBitboard(fromSquare), pushDirection) & emptyBitboard;
+        Bitboard doublePushBitboard = BB::Shift(pushBitboard, pushDirection) & emptyBitboard &
+                                      doublePushRankBitboard;
 
-        checkMaskBitboard = MoveTables::BETWEEN_TABLE[kingSquare][checkerSquare] | checkersBitboard;
+        targetsBitboard = pushBitboard | doublePushBitboard |
+                          (MoveTables::PAWN_ATTACK_TABLE[activeColour][fromSquare] &
+                           position.GetOccupancyBitboard(~activeColour));
+    }
+    else
+    {
+        targetsBitboard = GetPieceAttacks(pieceType, fromSquare, position.GetAllOccupancyBitboard()) &
+                          (~position.GetOccupancyBitboard(activeColour));
     }
 
-    // !EXPLAIN!
-    Bitboard enemyBishopsAndQueensBitboard =
-        position.GetPieceBitboard(enemyColour == WHITE ? WHITE_BISHOP : BLACK_BISHOP) |
-        position.GetPieceBitboard(enemyColour == WHITE ? WHITE_QUEEN  : BLACK_QUEEN);
-    Bitboard enemyRooksAndQueensBitboard =
-        position.GetPieceBitboard(enemyColour == WHITE ? WHITE_ROOK  : BLACK_ROOK) |
-        position.GetPieceBitboard(enemyColour == WHITE ? WHITE_QUEEN : BLACK_QUEEN);
+    targetsBitboard &= kingSafety.checkMaskBitboard;
 
-    Bitboard pinnersBitboard =
-        (MoveTables::GetBishopMoves(kingSquare, enemyOccupancyBitboard) & enemyBishopsAndQueensBitboard) |
-        (MoveTables::GetRookMoves(kingSquare, enemyOccupancyBitboard) & enemyRooksAndQueensBitboard);
+    // A pinned piece can only move along the line through its king.
+    if (kingSafety.pinnedBitboard & SquareToBitboard(fromSquare))
+    {
+        targetsBitboard &= MoveTables::LINE_TABLE[kingSafety.kingSquare][fromSquare];
+    }
 
-    Bitboard pinnedBitboard = 0ULL;
-    while (pinnersBitboard)
+    return targetsBitboard;
+}
+
+// The en passant capture the pawn on the square can make, or a null move if there is none.
+static Move GetEnPassantCapture(const Position& position, Square fromSquare)
+{
+    Square enPassantTargetSquare = position.GetEnPassantTargetSquare();
+
+    if (enPassantTargetSquare == NO_SQUARE ||
+        !(MoveTables::PAWN_ATTACK_TABLE[position.GetActiveColour()][fromSquare] &
+          SquareToBitboard(enPassantTargetSquare)))
     {
-        Square pinnerSquare = Square(BB::PopLSB(pinnersBitboard));
-        Bitboard betweenBitboard = MoveTables::BETWEEN_TABLE[kingSquare][pinnerSquare] &
-                                   friendlyOccupancyBitboard;
+        return Move();
+    }
 
-        if (BB::CountBits(betweenBitboard) == 1)
-        {
-            pinnedBitboard |= betweenBitboard;
-        }
+    return Move(fromSquare, enPassantTargetSquare, Move::EN_PASSANT_CAPTURE);
+}
+
+// Stops at the first legal move found. The king is tried first, as it is the only piece that can
+// answer a double check, and castling is never needed: a king that can castle can also step onto
+// the square it passes through.
+bool HasLegalMove(const Position& position)
+{
+    KingSafety kingSafety = GetKingSafety(position);
+
+    if (GetSafeKingTargets(position, kingSafety))
+    {
+        return true;
     }
 
-    for (size_t moveIndex = 0; moveIndex < pseudoLegalMoves.Size(); ++moveIndex)
+    if (!kingSafety.checkMaskBitboard)
     {
-        Move move = pseudoLegalMoves[moveIndex];
+        return false;
+    }
 
-        Square fromSquare = move.GetFromSquare();
-        Square toSquare = move.GetToSquare();
+    Colour activeColour = position.GetActiveColour();
+
+    Bitboard friendlyBitboard = position.GetOccupancyBitboard(activeColour) &
+                                (~SquareToBitboard(kingSafety.kingSquare));
 
-        // King moves
-        if (fromSquare == kingSquare)
+    while (friendlyBitboard)
+    {
+        Square fromSquare = Square(BB::PopLSB(friendlyBitboard));
+        PieceType pieceType = GetType(position.GetPiece(fromSquare));
+
+        if (GetLegalTargets(position, kingSafety, pieceType, fromSquare))
         {
-            if (move.GetFlag() == Move::KING_CASTLE || move.GetFlag() == Move::QUEEN_CASTLE)
-            {
-                Square transitSquare = move.GetFlag() == Move::KING_CASTLE ? fromSquare + EAST
-                                                                           : fromSquare + WEST;
-
-                if (checkersBitboard ||
-                    GetAttackersToSquare(position, transitSquare, enemyColour, allOccupancyBitboard) ||
-                    GetAttackersToSquare(position, toSquare, enemyColour, allOccupancyBitboard))
-                {
-                    continue;
-                }
-            }
-            // !EXPLAIN!
-            else if (GetAttackersToSquare(position, toSquare, enemyColour,
-                                          allOccupancyBitboard ^ friendlyKingBitboard))
-            {
-                continue;
-            }
+            return true;
         }
-        // !EXPLAIN!
-        else if (move.GetFlag() == Move::EN_PASSANT_CAPTURE)
+
+        if (pieceType == PAWN)
         {
-            Bitboard capturedPawnBitboard = SquareToBitboard(toSquare - pushDirection);
-            Bitboard occupancyBitboard = (allOccupancyBitboard ^ SquareToBitboard(fromSquare) ^
-                                          capturedPawnBitboard) | SquareToBitboard(toSquare);
+            Move enPassantCapture = GetEnPassantCapture(position, fromSquare);
 
-            if (GetAttackersToSquare(position, kingSquare, enemyColour, occupancyBitboard) &
-                (~capturedPawnBitboard))
+            if (!enPassantCapture.IsNull() && IsKingSafeAfterMove(position, kingSafety, enPassantCapture))
             {
-                continue;
+                return true;
             }
         }
-        // Pinned and checked pieces
-        else
+    }
+
+    return false;
+}
+
+size_t CountLegalMoves(const Position& position)
+{
+    KingSafety kingSafety = GetKingSafety(position);
+
+    Colour activeColour = position.GetActiveColour();
+
+    size_t moveCount = size_t(BB::CountBits(GetSafeKingTargets(position, kingSafety)));
+
+    // Castling
+    for (Move::MoveFlag castlingFlag : { Move::KING_CASTLE, Move::QUEEN_CASTLE })
+    {
+        Move castlingMove = GetCastlingMove(position, kingSafety.kingSquare, castlingFlag);
+
+        if (!castlingMove.IsNull() && IsKingSafeAfterMove(position, kingSafety, castlingMove))
         {
-            if (!(checkMaskBitboard & SquareToBitboard(toSquare)))
-            {
-                continue;
-            }
+            ++moveCount;
+        }
+    }
 
-            if ((pinnedBitboard & SquareToBitboard(fromSquare)) &&
-                !(MoveTables::LINE_TABLE[kingSquare][fromSquare] & SquareToBitboard(toSquare)))
-            {
-                continue;
-            }
+    if (!kingSafety.checkMaskBitboard)
+    {
+        return moveCount;
+    }
+
+    Bitboard promotionRankBitboard = RankToBitboard(activeColour == WHITE ? RANK_8 : RANK_1);
+
+    Bitboard friendlyBitboard = position.GetOccupancyBitboard(activeColour) &
+                                (~SquareToBitboard(kingSafety.kingSquare));
+
+    while (friendlyBitboard)
+    {
+        Square fromSquare = Square(BB::PopLSB(friendlyBitboard));
+        PieceType pieceType = GetType(position.GetPiece(fromSquare));
+
+        Bitboard targetsBitboard = GetLegalTargets(position, kingSafety, pieceType, fromSquare);
+
+        if (pieceType != PAWN)
+        {
+            moveCount += size_t(BB::CountBits(targetsBitboard));
+
+            continue;
         }
 
-        legalMoves.AddMove(move);
+        moveCount += size_t(BB::CountBits(targetsBitboard & (~promotionRankBitboard))) +
+                     4U * size_t(BB::CountBits(targetsBitboard & promotionRankBitboard));
+
+        Move enPassantCapture = GetEnPassantCapture(position, fromSquare);
+
+        if (!enPassantCapture.IsNull() && IsKingSafeAfterMove(position, kingSafety, enPassantCapture))
+        {
+            ++moveCount;
+        }
     }
 
-    return legalMoves;
+    return moveCount;
+}
+
+Move ParseLegalMove(const Position& position, const std::string& moveString)
+{
+    const MoveList moves = GenerateLegalMoves(position);
+
+    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    {
+        if (moves[moveIndex].ToString() == moveString)
+        {
+            return moves[moveIndex];
+        }
+    }
+
+    return Move();
 }
 
-} // namespace Gluon
\ No newline at end of file
+} // namespace Gluon
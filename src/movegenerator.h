@@ -3,10 +3,34 @@
 #include "movelist.h"
 #include "position.h"
 
+#include <cstdint>
+#include <string>
+
 namespace Gluon {
 
-MoveList GeneratePseudoLegalMoves(const Position& position, bool capturesOnly = false);
+// Which moves to generate. Promotions count as captures, as both change the material on the board.
+enum MoveGenerationType : uint8_t
+{
+    ALL_MOVES,
+    CAPTURE_MOVES,
+    QUIET_MOVES
+};
+
+MoveList GeneratePseudoLegalMoves(const Position& position, MoveGenerationType generationType = ALL_MOVES);
+
+MoveList GenerateLegalMoves(const Position& position, MoveGenerationType generationType = ALL_MOVES);
+
+// Adds the legal moves to the end of the list instead of returning a new one.
+void GenerateLegalMoves(const Position& position, MoveList& moveList,
+                        MoveGenerationType generationType = ALL_MOVES);
+
+// Tells whether the side to move has a legal move, without generating them all.
+bool HasLegalMove(const Position& position);
+
+// Counts the legal moves without generating a list of them.
+size_t CountLegalMoves(const Position& position);
 
-MoveList GenerateLegalMoves(const Position& position, bool capturesOnly = false);
+// Finds the legal move written in UCI notation, or gives a null move if there is none.
+Move ParseLegalMove(const Position& position, const std::string& moveString);
 
 } // namespace Gluon
\ No newline at end of file
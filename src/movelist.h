@@ -9,6 +9,8 @@ namespace Gluon {
 class MoveList
 {
 public:
+    static constexpr size_t MAX_MOVES = 256;
+
     MoveList()
         : size(0) {}
 
@@ -18,6 +20,16 @@ public:
         moves[size++] = move;
     }
 
+    inline void Clear()
+    {
+        size = 0;
+    }
+
+    inline Move& operator[](size_t index)
+    {
+        return moves[index];
+    }
+
     inline const Move& operator[](size_t index) const
     {
         return moves[index];
@@ -28,9 +40,20 @@ public:
         return size;
     }
 
-private:
-    static constexpr size_t MAX_MOVES = 256;
+    inline bool Contains(Move move) const
+    {
+        for (size_t moveIndex = 0; moveIndex < size; ++moveIndex)
+        {
+            if (moves[moveIndex] == move)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
 
+private:
     std::array<Move, MAX_MOVES> moves;
 
     size_t size;
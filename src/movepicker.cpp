@@ -0,0 +1,324 @@
+#include "movepicker.h"
+
+#include "evaluation.h"
+#include "movegenerator.h"
+
+#include <utility>
+
+namespace Gluon {
+
+// [ Capture ordering ]
+static constexpr std::array<int, NUM_PIECE_TYPES> ORDERING_PIECE_VALUE_TABLE = { 100, 300, 300, 500, 900, 0 };
+
+// Weighs the captured piece above the capturing one, so the most valuable victim comes first and
+// ties go to the least valuable attacker.
+static constexpr int VICTIM_VALUE_WEIGHT = 16;
+
+// Large enough to push any bad capture below zero, which is what marks it as bad.
+static constexpr int BAD_CAPTURE_PENALTY = 2 * VICTIM_VALUE_WEIGHT * ORDERING_PIECE_VALUE_TABLE[PieceTypeToIndex(QUEEN)];
+
+static int GetOrderingValue(PieceType pieceType)
+{
+    return ORDERING_PIECE_VALUE_TABLE[PieceTypeToIndex(pieceType)];
+}
+
+// Swaps the best scored move left into the given index and returns it.
+static Move SelectNextMove(MoveList& moves, std::array<int, MoveList::MAX_MOVES>& scores, size_t index)
+{
+    size_t bestIndex = index;
+
+    for (size_t moveIndex = index + 1U; moveIndex < moves.Size(); ++moveIndex)
+    {
+        if (scores[moveIndex] > scores[bestIndex])
+        {
+            bestIndex = moveIndex;
+        }
+    }
+
+    std::swap(moves[index], moves[bestIndex]);
+    std::swap(scores[index], scores[bestIndex]);
+
+    return moves[index];
+}
+
+// [ Constructors ]
+MovePicker::MovePicker(const Position& searchPosition, MovePickerBuffers& buffers, Move storedHashMove,
+                       const KillerMoves& killerMoves, Move counterMove,
+                       const HistoryTable& quietHistoryTable)
+    : position(searchPosition),
+      hashMove(storedHashMove),
+      refutationMoves{ killerMoves[0], killerMoves[1], counterMove },
+      historyTable(&quietHistoryTable),
+      stage(HASH_MOVE_STAGE),
+      captures(buffers.captures),
+      captureScores(buffers.captureScores),
+      captureIndex(0),
+      badCaptureCount(0),
+      quiets(buffers.quiets),
+      quietScores(buffers.quietScores),
+      quietIndex(0),
+      refutationIndex(0),
+      skipQuietMoves(false)
+{
+    static_assert(NUM_KILLER_MOVES == 2);
+
+    // A counter move that is also a killer would otherwise be handed out twice.
+    if (counterMove == killerMoves[0] || counterMove == killerMoves[1])
+    {
+        refutationMoves[NUM_KILLER_MOVES] = Move();
+    }
+}
+
+MovePicker::MovePicker(const Position& searchPosition, MovePickerBuffers& buffers, Move storedHashMove)
+    : position(searchPosition),
+      hashMove(storedHashMove),
+      refutationMoves(),
+      historyTable(nullptr),
+      stage(QUIESCENCE_HASH_MOVE_STAGE),
+      captures(buffers.captures),
+      captureScores(buffers.captureScores),
+      captureIndex(0),
+      badCaptureCount(0),
+      quiets(buffers.quiets),
+      quietScores(buffers.quietScores),
+      quietIndex(0),
+      refutationIndex(0),
+      skipQuietMoves(false) {}
+
+// [ Public methods ]
+Move MovePicker::NextMove()
+{
+    switch (stage)
+    {
+        case HASH_MOVE_STAGE:
+            stage = GENERATE_CAPTURES_STAGE;
+
+            // The stored move can come from another position that shares the hash key.
+            if (position.IsPseudoLegal(hashMove) && position.IsLegal(hashMove))
+            {
+                return hashMove;
+            }
+
+            return NextMove();
+
+        case GENERATE_CAPTURES_STAGE:
+            captures.Clear();
+
+            GenerateLegalMoves(position, captures, CAPTURE_MOVES);
+
+            ScoreCaptures();
+
+            stage = GOOD_CAPTURES_STAGE;
+
+            return NextMove();
+
+        case GOOD_CAPTURES_STAGE:
+            while (captureIndex < captures.Size())
+            {
+                const Move move = SelectNextMove(captures, captureScores, captureIndex);
+                const int score = captureScores[captureIndex++];
+
+                if (move == hashMove)
+                {
+                    continue;
+                }
+
+                // Kept at the front of the list, which has already been handed out, for the last stage.
+                if (score < 0)
+                {
+                    captures[badCaptureCount++] = move;
+
+                    continue;
+                }
+
+                return move;
+            }
+
+            stage = REFUTATION_MOVES_STAGE;
+
+            return NextMove();
+
+        case REFUTATION_MOVES_STAGE:
+            while (refutationIndex < refutationMoves.size() && !skipQuietMoves)
+            {
+                const Move move = refutationMoves[refutationIndex++];
+
+                if (!(move == hashMove) && !move.IsCapture() && !move.IsPromotion() &&
+                    position.IsPseudoLegal(move) && position.IsLegal(move))
+                {
+                    return move;
+                }
+            }
+
+            stage = GENERATE_QUIETS_STAGE;
+
+            return NextMove();
+
+        case GENERATE_QUIETS_STAGE:
+            if (skipQuietMoves)
+            {
+                stage = BAD_CAPTURES_STAGE;
+                captureIndex = 0;
+
+                return NextMove();
+            }
+
+            quiets.Clear();
+
+            GenerateLegalMoves(position, quiets, QUIET_MOVES);
+
+            ScoreQuiets();
+
+            stage = QUIET_MOVES_STAGE;
+
+            return NextMove();
+
+        case QUIET_MOVES_STAGE:
+            while (quietIndex < quiets.Size() && !skipQuietMoves)
+            {
+                const Move move = SelectNextMove(quiets, quietScores, quietIndex++);
+
+                if (!IsHashOrRefutationMove(move))
+                {
+                    return move;
+                }
+            }
+
+            stage = BAD_CAPTURES_STAGE;
+            captureIndex = 0;
+
+            return NextMove();
+
+        case BAD_CAPTURES_STAGE:
+            if (captureIndex < badCaptureCount)
+            {
+                return captures[captureIndex++];
+            }
+
+            stage = DONE_STAGE;
+
+            return Move();
+
+        case QUIESCENCE_HASH_MOVE_STAGE:
+            stage = GENERATE_QUIESCENCE_CAPTURES_STAGE;
+
+            // A quiet hash move, stored by the main search, is not for quiescence search to try.
+            if ((hashMove.IsCapture() || hashMove.IsPromotion()) && position.IsPseudoLegal(hashMove) &&
+                position.IsLegal(hashMove))
+            {
+                return hashMove;
+            }
+
+            hashMove = Move();
+
+            return NextMove();
+
+        case GENERATE_QUIESCENCE_CAPTURES_STAGE:
+            captures.Clear();
+
+            GenerateLegalMoves(position, captures, CAPTURE_MOVES);
+
+            ScoreCaptures();
+
+            stage = QUIESCENCE_CAPTURES_STAGE;
+
+            return NextMove();
+
+        case QUIESCENCE_CAPTURES_STAGE:
+            // Bad captures are sorted last and are not worth searching once only captures are left.
+            while (captureIndex < captures.Size())
+            {
+                const Move move = SelectNextMove(captures, captureScores, captureIndex);
+
+                if (captureScores[captureIndex++] < 0)
+                {
+                    break;
+                }
+
+                if (!(move == hashMove))
+                {
+                    return move;
+                }
+            }
+
+            stage = DONE_STAGE;
+
+            return Move();
+
+        case DONE_STAGE:
+            return Move();
+    }
+
+    return Move();
+}
+
+void MovePicker::SkipQuietMoves()
+{
+    skipQuietMoves = true;
+}
+
+// [ Private methods ]
+// Most valuable victim, least valuable attacker, with promotions scored by the piece they gain and
+// captures that lose material pushed below zero.
+void MovePicker::ScoreCaptures()
+{
+    for (size_t moveIndex = 0; moveIndex < captures.Size(); ++moveIndex)
+    {
+        const Move move = captures[moveIndex];
+
+        const PieceType attackerType = GetType(position.GetPiece(move.GetFromSquare()));
+        const PieceType victimType = move.GetFlag() == Move::EN_PASSANT_CAPTURE ? PAWN
+                                   : move.IsCapture() ? GetType(position.GetPiece(move.GetToSquare()))
+                                                      : NO_PIECE_TYPE;
+
+        const int victimValue = victimType == NO_PIECE_TYPE ? 0 : GetOrderingValue(victimType);
+        const int attackerValue = GetOrderingValue(attackerType);
+
+        int score = VICTIM_VALUE_WEIGHT * victimValue - attackerValue;
+
+        if (move.IsPromotion())
+        {
+            score += VICTIM_VALUE_WEIGHT * (GetOrderingValue(move.GetPromotionPieceType()) -
+                                            GetOrderingValue(PAWN));
+        }
+
+        // Captures that lose material in the exchange that follows wait until after the quiet moves,
+        // as do underpromotions, which are almost never better than promoting to a queen.
+        const bool isBadCapture = (move.IsPromotion() && move.GetPromotionPieceType() != QUEEN) ||
+                                  !position.SEE(move, 0);
+
+        captureScores[moveIndex] = isBadCapture ? score - BAD_CAPTURE_PENALTY : score;
+    }
+}
+
+void MovePicker::ScoreQuiets()
+{
+    const Colour activeColour = position.GetActiveColour();
+
+    for (size_t moveIndex = 0; moveIndex < quiets.Size(); ++moveIndex)
+    {
+        const Move move = quiets[moveIndex];
+
+        quietScores[moveIndex] = (*historyTable)[activeColour][move.GetFromSquare()][move.GetToSquare()];
+    }
+}
+
+bool MovePicker::IsHashOrRefutationMove(Move move) const
+{
+    if (move == hashMove)
+    {
+        return true;
+    }
+
+    for (const Move refutationMove : refutationMoves)
+    {
+        if (move == refutationMove)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace Gluon
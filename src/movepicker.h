@@ -0,0 +1,118 @@
+#pragma once
+
+#include "move.h"
+#include "movelist.h"
+#include "position.h"
+
+#include <array>
+#include <cstdint>
+
+namespace Gluon {
+
+constexpr size_t NUM_KILLER_MOVES = 2;
+
+// Quiet moves that caused a cut-off at the same ply elsewhere in the tree.
+using KillerMoves = std::array<Move, NUM_KILLER_MOVES>;
+
+// How often each quiet move has caused a cut-off, by side to move, from square and to square.
+using HistoryTable = std::array<std::array<std::array<int, NUM_SQUARES>, NUM_SQUARES>, NUM_COLOURS>;
+
+// The quiet move that last refuted each move, by the refuted move's from square and to square.
+using CounterMoveTable = std::array<std::array<Move, NUM_SQUARES>, NUM_SQUARES>;
+
+// The lists a move picker generates and scores its moves in. They are kept apart from the picker so
+// that the search can reuse one set for every node at the same ply.
+struct MovePickerBuffers
+{
+    MoveList captures;
+
+    std::array<int, MoveList::MAX_MOVES> captureScores;
+
+    MoveList quiets;
+
+    std::array<int, MoveList::MAX_MOVES> quietScores;
+};
+
+// Hands out the legal moves of a position one at a time, most promising first. Each stage is only
+// generated once the search has used up the stages before it, so a cut-off on an early move saves
+// the work of generating and scoring the rest.
+class MovePicker
+{
+public:
+    // [ Constructors ]
+    // For the main search: the hash move, captures that win material, the killer moves and the
+    // counter move, quiet moves by history, and last of all captures that lose material.
+    MovePicker(const Position& position, MovePickerBuffers& buffers, Move hashMove,
+               const KillerMoves& killerMoves, Move counterMove, const HistoryTable& historyTable);
+
+    // For quiescence search: the hash move if it is a capture or promotion, then the other captures
+    // and promotions, best first, leaving out the bad ones.
+    MovePicker(const Position& position, MovePickerBuffers& buffers, Move hashMove);
+
+    // [ Public methods ]
+    // Gives a null move once every move has been handed out.
+    Move NextMove();
+
+    // Goes straight on to the bad captures, for when the search will not look at any more quiet moves.
+    void SkipQuietMoves();
+
+private:
+    // [ Stages ]
+    enum Stage : uint8_t
+    {
+        HASH_MOVE_STAGE,
+        GENERATE_CAPTURES_STAGE,
+        GOOD_CAPTURES_STAGE,
+        REFUTATION_MOVES_STAGE,
+        GENERATE_QUIETS_STAGE,
+        QUIET_MOVES_STAGE,
+        BAD_CAPTURES_STAGE,
+
+        QUIESCENCE_HASH_MOVE_STAGE,
+        GENERATE_QUIESCENCE_CAPTURES_STAGE,
+        QUIESCENCE_CAPTURES_STAGE,
+
+        DONE_STAGE
+    };
+
+    // [ Private methods ]
+    void ScoreCaptures();
+
+    void ScoreQuiets();
+
+    // Moves already handed out by an earlier stage, which the quiet stage must skip.
+    bool IsHashOrRefutationMove(Move move) const;
+
+    // [ Data members ]
+    const Position& position;
+
+    Move hashMove;
+
+    // The killer moves followed by the counter move, all tried before the other quiet moves.
+    std::array<Move, NUM_KILLER_MOVES + 1U> refutationMoves;
+
+    const HistoryTable* historyTable;
+
+    Stage stage;
+
+    MoveList& captures;
+
+    std::array<int, MoveList::MAX_MOVES>& captureScores;
+
+    size_t captureIndex;
+
+    // Bad captures are moved to the front of the capture list as they are skipped over.
+    size_t badCaptureCount;
+
+    MoveList& quiets;
+
+    std::array<int, MoveList::MAX_MOVES>& quietScores;
+
+    size_t quietIndex;
+
+    size_t refutationIndex;
+
+    bool skipQuietMoves;
+};
+
+} // namespace Gluon
@@ -1,6 +1,7 @@
 #include "position.h"
 
 #include "bitboard.h"
+#include "evaluation.h"
 #include "movetables.h"
 #include "zobrist.h"
 
@@ -9,6 +10,25 @@
 
 namespace Gluon {
 
+// [ Static exchange evaluation ]
+static constexpr std::array<int, NUM_PIECE_TYPES> SEE_PIECE_VALUE_TABLE = { 100, 300, 300, 500, 900, 0 };
+
+// Cheapest first, which is the order each side recaptures in.
+static constexpr std::array<PieceType, NUM_PIECE_TYPES> SEE_ATTACKER_ORDER = { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+static int GetSEEValue(PieceType pieceType)
+{
+    return SEE_PIECE_VALUE_TABLE[PieceTypeToIndex(pieceType)];
+}
+
+// Nothing when there is no en passant square, so the key can be updated without checking first.
+static HashKey GetEnPassantKey(Square enPassantTargetSquare)
+{
+    return enPassantTargetSquare == NO_SQUARE
+           ? 0ULL
+           : Zobrist::KEYS.enPassantFileKeys[SquareToFile(enPassantTargetSquare)];
+}
+
 // [ Constructors ]
 Position::Position()
 {
@@ -44,6 +64,7 @@ void Position::SetupWithFEN(const std::string& fen)
         {
             Piece piece = CharToPiece(pieceChar);
             SetSquare(currentSquare, piece);
+            UpdateKeysWithPiece(currentSquare);
             currentSquare = currentSquare + EAST;
         }
     }
@@ -51,34 +72,38 @@ void Position::SetupWithFEN(const std::string& fen)
     // Set active colour
     activeColour = activeColourString == "w" ? WHITE : BLACK;
 
+    StateInfo& state = states[stateIndex];
+
     // Set castling rights
     for (char castlingRightChar : castlingRightsString)
     {
         switch (castlingRightChar)
         {
-            case 'K': castlingRights |= WHITE_OO;  break;
-            case 'Q': castlingRights |= WHITE_OOO; break;
-            case 'k': castlingRights |= BLACK_OO;  break;
-            case 'q': castlingRights |= BLACK_OOO; break;
+            case 'K': state.castlingRights |= WHITE_OO;  break;
+            case 'Q': state.castlingRights |= WHITE_OOO; break;
+            case 'k': state.castlingRights |= BLACK_OO;  break;
+            case 'q': state.castlingRights |= BLACK_OOO; break;
         }
     }
 
     // Set en passant target square
-    enPassantTargetSquare = (enPassantTargetSquareString == "-")
-                            ? NO_SQUARE
-                            : CoordStringToSquare(enPassantTargetSquareString);
+    state.enPassantTargetSquare = (enPassantTargetSquareString == "-")
+                                  ? NO_SQUARE
+                                  : CoordStringToSquare(enPassantTargetSquareString);
 
     // Set half move clock
-    halfMoveClock = halfMoveClockString.length() > 0 ? std::stoi(halfMoveClockString) : 0;
+    state.halfMoveClock = halfMoveClockString.length() > 0 ? std::stoi(halfMoveClockString) : 0;
 
     // Set full move number
     fullMoveNumber = fullMoveNumberString.length() > 0 ? std::stoi(fullMoveNumberString) : 1;
 
-    // Set the hash key, the pieces having already been folded in by SetSquare
+    // Set the hash key, the pieces having already been folded in as they were placed
     UpdateHashKeyWithState();
+
+    UpdateCheckInfo();
 }
 
-void Position::MakeMove(Move move, PositionState& state)
+void Position::MakeMove(Move move)
 {
     Square fromSquare = move.GetFromSquare();
     Square toSquare = move.GetToSquare();
@@ -87,36 +112,34 @@ void Position::MakeMove(Move move, PositionState& state)
     Piece movedPiece = squares[fromSquare];
     Direction pushDirection = activeColour == WHITE ? NORTH : SOUTH;
 
-    hashKeyHistory.push_back(hashKey);
+    StateInfo& state = PushState();
 
-    // !EXPLAIN!
-    UpdateHashKeyWithState();
-
-    // Save the state the move destroys
     state.capturedPiece = moveFlag == Move::EN_PASSANT_CAPTURE ? squares[toSquare - pushDirection]
                                                                : squares[toSquare];
-    state.castlingRights = castlingRights;
-    state.enPassantTargetSquare = enPassantTargetSquare;
-    state.halfMoveClock = halfMoveClock;
 
     // Remove the captured piece
     if (moveFlag == Move::EN_PASSANT_CAPTURE)
     {
+        UpdateKeysWithPiece(toSquare - pushDirection);
         ClearSquare(toSquare - pushDirection);
     }
     else if (move.IsCapture())
     {
+        UpdateKeysWithPiece(toSquare);
         ClearSquare(toSquare);
     }
 
     // Move the piece
     MovePiece(fromSquare, toSquare);
+    UpdateKeysWithPieceMove(fromSquare, toSquare);
 
     // Replace a promoting pawn
     if (move.IsPromotion())
     {
+        UpdateKeysWithPiece(toSquare);
         ClearSquare(toSquare);
         SetSquare(toSquare, MakePiece(activeColour, move.GetPromotionPieceType()));
+        UpdateKeysWithPiece(toSquare);
     }
 
     // !EXPLAIN!
@@ -124,23 +147,28 @@ void Position::MakeMove(Move move, PositionState& state)
     if (moveFlag == Move::KING_CASTLE)
     {
         MovePiece(toSquare + EAST, toSquare + WEST);
+        UpdateKeysWithPieceMove(toSquare + EAST, toSquare + WEST);
     }
     else if (moveFlag == Move::QUEEN_CASTLE)
     {
         MovePiece(toSquare + WEST + WEST, toSquare + EAST);
+        UpdateKeysWithPieceMove(toSquare + WEST + WEST, toSquare + EAST);
     }
 
+    const CastlingRight previousCastlingRights = state.castlingRights;
+    const Square previousEnPassantTargetSquare = state.enPassantTargetSquare;
+
     // !EXPLAIN!
     // Update castling rights
-    castlingRights = CastlingRight(castlingRights &
-                                   MoveTables::CASTLING_RIGHT_MASK_TABLE[fromSquare] &
-                                   MoveTables::CASTLING_RIGHT_MASK_TABLE[toSquare]);
+    state.castlingRights = CastlingRight(state.castlingRights &
+                                         MoveTables::CASTLING_RIGHT_MASK_TABLE[fromSquare] &
+                                         MoveTables::CASTLING_RIGHT_MASK_TABLE[toSquare]);
 
     // Update en passant target square
-    enPassantTargetSquare = moveFlag == Move::DOUBLE_PAWN_PUSH ? toSquare - pushDirection : NO_SQUARE;
+    state.enPassantTargetSquare = moveFlag == Move::DOUBLE_PAWN_PUSH ? toSquare - pushDirection : NO_SQUARE;
 
     // Update move counters
-    halfMoveClock = (GetType(movedPiece) == PAWN || move.IsCapture()) ? 0 : halfMoveClock + 1;
+    state.halfMoveClock = (GetType(movedPiece) == PAWN || move.IsCapture()) ? 0 : state.halfMoveClock + 1;
 
     if (activeColour == BLACK)
     {
@@ -149,17 +177,29 @@ void Position::MakeMove(Move move, PositionState& state)
 
     activeColour = ~activeColour;
 
-    UpdateHashKeyWithState();
+    // Only the parts of the key the move changed are updated.
+    if (state.castlingRights != previousCastlingRights)
+    {
+        state.hashKey ^= Zobrist::KEYS.castlingRightKeys[previousCastlingRights] ^
+                         Zobrist::KEYS.castlingRightKeys[state.castlingRights];
+    }
+
+    state.hashKey ^= GetEnPassantKey(previousEnPassantTargetSquare) ^
+                     GetEnPassantKey(state.enPassantTargetSquare) ^
+                     Zobrist::KEYS.sideToMoveKey;
+
+    UpdateCheckInfo();
 }
 
-void Position::UnmakeMove(Move move, const PositionState& state)
+// The keys of the state before the move are still there to go back to, so only the board has to be
+// put back.
+void Position::UnmakeMove(Move move)
 {
     Square fromSquare = move.GetFromSquare();
     Square toSquare = move.GetToSquare();
     Move::MoveFlag moveFlag = move.GetFlag();
 
-    // !EXPLAIN!
-    UpdateHashKeyWithState();
+    const StateInfo& state = states[stateIndex];
 
     activeColour = ~activeColour;
 
@@ -195,51 +235,412 @@ void Position::UnmakeMove(Move move, const PositionState& state)
         MovePiece(toSquare + EAST, toSquare + WEST + WEST);
     }
 
-    // Restore the saved state
-    castlingRights = state.castlingRights;
-    enPassantTargetSquare = state.enPassantTargetSquare;
-    halfMoveClock = state.halfMoveClock;
-
     if (activeColour == BLACK)
     {
         --fullMoveNumber;
     }
 
-    UpdateHashKeyWithState();
+    --stateIndex;
+}
+
+void Position::MakeNullMove()
+{
+    StateInfo& state = PushState();
+
+    state.hashKey ^= GetEnPassantKey(state.enPassantTargetSquare) ^ Zobrist::KEYS.sideToMoveKey;
 
-    hashKeyHistory.pop_back();
+    state.capturedPiece = NO_PIECE;
+    state.enPassantTargetSquare = NO_SQUARE;
+
+    // No position before a null move can repeat after it, and a cleared clock stops the lookback.
+    state.halfMoveClock = 0;
+
+    activeColour = ~activeColour;
+
+    UpdateCheckInfo();
+}
+
+void Position::UnmakeNullMove()
+{
+    activeColour = ~activeColour;
+
+    --stateIndex;
 }
 
 // !EXPLAIN!
-bool Position::IsInCheck() const
+Bitboard Position::GetAttackersToSquare(Square square, Colour attackerColour, Bitboard occupancyBitboard) const
 {
-    Colour enemyColour = ~activeColour;
+    Bitboard pawnBitboard   = GetPieceBitboard(MakePiece(attackerColour, PAWN));
+    Bitboard knightBitboard = GetPieceBitboard(MakePiece(attackerColour, KNIGHT));
+    Bitboard bishopBitboard = GetPieceBitboard(MakePiece(attackerColour, BISHOP));
+    Bitboard rookBitboard   = GetPieceBitboard(MakePiece(attackerColour, ROOK));
+    Bitboard queenBitboard  = GetPieceBitboard(MakePiece(attackerColour, QUEEN));
+    Bitboard kingBitboard   = GetPieceBitboard(MakePiece(attackerColour, KING));
+
+    return (MoveTables::PAWN_ATTACK_TABLE[~attackerColour][square] & pawnBitboard)                       |
+           (MoveTables::KNIGHT_MOVE_TABLE[square] & knightBitboard)                                      |
+           (MoveTables::KING_MOVE_TABLE[square] & kingBitboard)                                          |
+           (MoveTables::GetBishopMoves(square, occupancyBitboard) & (bishopBitboard | queenBitboard))    |
+           (MoveTables::GetRookMoves(square, occupancyBitboard) & (rookBitboard | queenBitboard));
+}
+
+bool Position::SEE(Move move, int threshold) const
+{
+    // Castling never puts a piece where it can be taken for nothing.
+    if (move.GetFlag() == Move::KING_CASTLE || move.GetFlag() == Move::QUEEN_CASTLE)
+    {
+        return threshold <= 0;
+    }
+
+    const Square fromSquare = move.GetFromSquare();
+    const Square toSquare = move.GetToSquare();
+
+    Bitboard occupancyBitboard = (allOccupancyBitboard ^ SquareToBitboard(fromSquare)) | SquareToBitboard(toSquare);
+
+    int capturedValue = 0;
+
+    if (move.GetFlag() == Move::EN_PASSANT_CAPTURE)
+    {
+        capturedValue = GetSEEValue(PAWN);
+
+        occupancyBitboard ^= SquareToBitboard(toSquare - (activeColour == WHITE ? NORTH : SOUTH));
+    }
+    else if (move.IsCapture())
+    {
+        capturedValue = GetSEEValue(GetType(squares[toSquare]));
+    }
+
+    PieceType pieceOnSquare = GetType(squares[fromSquare]);
+
+    if (move.IsPromotion())
+    {
+        pieceOnSquare = move.GetPromotionPieceType();
+        capturedValue += GetSEEValue(pieceOnSquare) - GetSEEValue(PAWN);
+    }
+
+    // What the side that captured last would lose, net of what it has gained so far, if its piece
+    // were taken back. The threshold is counted against the side that made the move.
+    int swap = capturedValue - threshold;
+
+    // Even keeping the piece for free does not reach the threshold.
+    if (swap < 0)
+    {
+        return false;
+    }
+
+    swap = GetSEEValue(pieceOnSquare) - swap;
+
+    // Even losing the piece for nothing still reaches it.
+    if (swap <= 0)
+    {
+        return true;
+    }
+
+    const Bitboard diagonalSlidersBitboard = GetPieceBitboard(WHITE_BISHOP) | GetPieceBitboard(BLACK_BISHOP) |
+                                             GetPieceBitboard(WHITE_QUEEN)  | GetPieceBitboard(BLACK_QUEEN);
+    const Bitboard straightSlidersBitboard = GetPieceBitboard(WHITE_ROOK)   | GetPieceBitboard(BLACK_ROOK)   |
+                                             GetPieceBitboard(WHITE_QUEEN)  | GetPieceBitboard(BLACK_QUEEN);
+
+    Bitboard attackersBitboard = GetAttackersToSquare(toSquare, WHITE, occupancyBitboard) |
+                                 GetAttackersToSquare(toSquare, BLACK, occupancyBitboard);
+
+    Colour sideToCapture = activeColour;
+
+    // Whether the side that made the move reaches the threshold if the exchange stops here, which
+    // flips with every capture made.
+    bool isMoverWinning = true;
 
-    Square kingSquare = Square(BB::GetLSB(GetPieceBitboard(MakePiece(activeColour, KING))));
+    while (true)
+    {
+        sideToCapture = ~sideToCapture;
+
+        attackersBitboard &= occupancyBitboard;
+
+        const Bitboard sideAttackersBitboard = attackersBitboard & colourOccupancyBitboards[sideToCapture];
+
+        if (!sideAttackersBitboard)
+        {
+            break;
+        }
+
+        isMoverWinning = !isMoverWinning;
+
+        PieceType attackerType = KING;
+
+        for (const PieceType pieceType : SEE_ATTACKER_ORDER)
+        {
+            if (sideAttackersBitboard & GetPieceBitboard(MakePiece(sideToCapture, pieceType)))
+            {
+                attackerType = pieceType;
+
+                break;
+            }
+        }
+
+        // Taking with the king is only legal if nothing can take back.
+        if (attackerType == KING)
+        {
+            return (attackersBitboard & colourOccupancyBitboards[~sideToCapture]) ? !isMoverWinning
+                                                                                  : isMoverWinning;
+        }
 
-    Bitboard enemyBishopsAndQueensBitboard = GetPieceBitboard(MakePiece(enemyColour, BISHOP)) |
-                                             GetPieceBitboard(MakePiece(enemyColour, QUEEN));
-    Bitboard enemyRooksAndQueensBitboard   = GetPieceBitboard(MakePiece(enemyColour, ROOK)) |
-                                             GetPieceBitboard(MakePiece(enemyColour, QUEEN));
+        // Stop once the side that has just captured stays ahead even after losing its piece.
+        swap = GetSEEValue(attackerType) - swap;
 
-    return (MoveTables::PAWN_ATTACK_TABLE[activeColour][kingSquare] &
-            GetPieceBitboard(MakePiece(enemyColour, PAWN)))                                          ||
-           (MoveTables::KNIGHT_MOVE_TABLE[kingSquare] & GetPieceBitboard(MakePiece(enemyColour, KNIGHT))) ||
-           (MoveTables::KING_MOVE_TABLE[kingSquare] & GetPieceBitboard(MakePiece(enemyColour, KING)))     ||
-           (MoveTables::GetBishopMoves(kingSquare, allOccupancyBitboard) & enemyBishopsAndQueensBitboard) ||
-           (MoveTables::GetRookMoves(kingSquare, allOccupancyBitboard) & enemyRooksAndQueensBitboard);
+        if (swap < int(isMoverWinning))
+        {
+            break;
+        }
+
+        const Bitboard attackerBitboard = sideAttackersBitboard & GetPieceBitboard(MakePiece(sideToCapture,
+                                                                                              attackerType));
+
+        occupancyBitboard ^= SquareToBitboard(Square(BB::GetLSB(attackerBitboard)));
+
+        // Taking a piece away can uncover a slider lined up behind it.
+        if (attackerType == PAWN || attackerType == BISHOP || attackerType == QUEEN)
+        {
+            attackersBitboard |= MoveTables::GetBishopMoves(toSquare, occupancyBitboard) & diagonalSlidersBitboard;
+        }
+
+        if (attackerType == ROOK || attackerType == QUEEN)
+        {
+            attackersBitboard |= MoveTables::GetRookMoves(toSquare, occupancyBitboard) & straightSlidersBitboard;
+        }
+    }
+
+    return isMoverWinning;
 }
 
 // !EXPLAIN!
+bool Position::GivesCheck(Move move) const
+{
+    Square fromSquare = move.GetFromSquare();
+    Square toSquare = move.GetToSquare();
+    Move::MoveFlag moveFlag = move.GetFlag();
+
+    Colour enemyColour = ~activeColour;
+    Square enemyKingSquare = GetKingSquare(enemyColour);
+
+    // A direct check, which a promoting pawn leaves to the piece it becomes.
+    if (!move.IsPromotion() && (GetCheckSquaresBitboard(GetType(squares[fromSquare])) & SquareToBitboard(toSquare)))
+    {
+        return true;
+    }
+
+    // A discovered check, unless the piece stays on the line to the king.
+    if ((GetBlockersForKingBitboard(enemyColour) & SquareToBitboard(fromSquare)) &&
+        !(MoveTables::LINE_TABLE[fromSquare][enemyKingSquare] & SquareToBitboard(toSquare)))
+    {
+        return true;
+    }
+
+    Bitboard occupancyBitboard = (allOccupancyBitboard ^ SquareToBitboard(fromSquare)) | SquareToBitboard(toSquare);
+
+    if (move.IsPromotion())
+    {
+        // Looked at through the square the pawn left, which can stand between the two.
+        switch (move.GetPromotionPieceType())
+        {
+            case KNIGHT:
+                return MoveTables::KNIGHT_MOVE_TABLE[toSquare] & SquareToBitboard(enemyKingSquare);
+            case BISHOP:
+                return MoveTables::GetBishopMoves(toSquare, occupancyBitboard) & SquareToBitboard(enemyKingSquare);
+            case ROOK:
+                return MoveTables::GetRookMoves(toSquare, occupancyBitboard) & SquareToBitboard(enemyKingSquare);
+            default:
+                return (MoveTables::GetBishopMoves(toSquare, occupancyBitboard) |
+                        MoveTables::GetRookMoves(toSquare, occupancyBitboard)) & SquareToBitboard(enemyKingSquare);
+        }
+    }
+
+    // Taking the pawn away as well can open a line that neither pawn blocks alone.
+    if (moveFlag == Move::EN_PASSANT_CAPTURE)
+    {
+        occupancyBitboard ^= SquareToBitboard(toSquare - (activeColour == WHITE ? NORTH : SOUTH));
+
+        Bitboard queenBitboard = GetPieceBitboard(MakePiece(activeColour, QUEEN));
+
+        return (MoveTables::GetBishopMoves(enemyKingSquare, occupancyBitboard) &
+                (GetPieceBitboard(MakePiece(activeColour, BISHOP)) | queenBitboard)) ||
+               (MoveTables::GetRookMoves(enemyKingSquare, occupancyBitboard) &
+                (GetPieceBitboard(MakePiece(activeColour, ROOK)) | queenBitboard));
+    }
+
+    // Only the rook can give check, from the square it lands on beside the king.
+    if (moveFlag == Move::KING_CASTLE || moveFlag == Move::QUEEN_CASTLE)
+    {
+        Square rookFromSquare = moveFlag == Move::KING_CASTLE ? toSquare + EAST : toSquare + WEST + WEST;
+        Square rookToSquare = moveFlag == Move::KING_CASTLE ? toSquare + WEST : toSquare + EAST;
+
+        occupancyBitboard = (occupancyBitboard ^ SquareToBitboard(rookFromSquare)) | SquareToBitboard(rookToSquare);
+
+        return MoveTables::GetRookMoves(rookToSquare, occupancyBitboard) & SquareToBitboard(enemyKingSquare);
+    }
+
+    return false;
+}
+
+bool Position::IsPseudoLegal(Move move) const
+{
+    Square fromSquare = move.GetFromSquare();
+    Square toSquare = move.GetToSquare();
+    Move::MoveFlag moveFlag = move.GetFlag();
+
+    Piece movedPiece = squares[fromSquare];
+
+    if (move.IsNull() || movedPiece == NO_PIECE || GetColour(movedPiece) != activeColour)
+    {
+        return false;
+    }
+
+    Colour enemyColour = ~activeColour;
+    PieceType movedPieceType = GetType(movedPiece);
+
+    if (moveFlag == Move::KING_CASTLE || moveFlag == Move::QUEEN_CASTLE)
+    {
+        bool isKingSide = moveFlag == Move::KING_CASTLE;
+
+        CastlingRight castlingRight = isKingSide ? (activeColour == WHITE ? WHITE_OO  : BLACK_OO)
+                                                 : (activeColour == WHITE ? WHITE_OOO : BLACK_OOO);
+
+        Bitboard pathBitboard = isKingSide ? (activeColour == WHITE ? MoveTables::WHITE_KING_SIDE_CASTLING_PATH
+                                                                    : MoveTables::BLACK_KING_SIDE_CASTLING_PATH)
+                                           : (activeColour == WHITE ? MoveTables::WHITE_QUEEN_SIDE_CASTLING_PATH
+                                                                    : MoveTables::BLACK_QUEEN_SIDE_CASTLING_PATH);
+
+        Square castlingToSquare = isKingSide ? (activeColour == WHITE ? SQUARE_G1 : SQUARE_G8)
+                                             : (activeColour == WHITE ? SQUARE_C1 : SQUARE_C8);
+
+        return movedPieceType == KING && toSquare == castlingToSquare && (GetCastlingRights() & castlingRight) &&
+               !(pathBitboard & allOccupancyBitboard);
+    }
+
+    // The flag has to agree with what is on the to square, or the move would take a piece that is
+    // not there or land on one without taking it.
+    if (moveFlag == Move::EN_PASSANT_CAPTURE)
+    {
+        return movedPieceType == PAWN && toSquare == GetEnPassantTargetSquare() &&
+               (MoveTables::PAWN_ATTACK_TABLE[activeColour][fromSquare] & SquareToBitboard(toSquare));
+    }
+
+    if (move.IsCapture() ? !(GetOccupancyBitboard(enemyColour) & SquareToBitboard(toSquare))
+                         : squares[toSquare] != NO_PIECE)
+    {
+        return false;
+    }
+
+    if (movedPieceType == PAWN)
+    {
+        Direction pushDirection = activeColour == WHITE ? NORTH : SOUTH;
+        Rank promotionRank = activeColour == WHITE ? RANK_8 : RANK_1;
+
+        if (move.IsPromotion() != (SquareToRank(toSquare) == promotionRank))
+        {
+            return false;
+        }
+
+        // A corrupt move can carry one of the capture flags that no move uses.
+        if (move.IsCapture())
+        {
+            return (move.IsPromotion() || moveFlag == Move::CAPTURE) &&
+                   (MoveTables::PAWN_ATTACK_TABLE[activeColour][fromSquare] & SquareToBitboard(toSquare));
+        }
+
+        if (moveFlag == Move::DOUBLE_PAWN_PUSH)
+        {
+            Rank startRank = activeColour == WHITE ? RANK_2 : RANK_7;
+
+            return SquareToRank(fromSquare) == startRank && toSquare == fromSquare + pushDirection + pushDirection &&
+                   squares[fromSquare + pushDirection] == NO_PIECE;
+        }
+
+        return toSquare == fromSquare + pushDirection;
+    }
+
+    // Only pawns push two squares or promote.
+    if (moveFlag != Move::QUIET_MOVE && moveFlag != Move::CAPTURE)
+    {
+        return false;
+    }
+
+    switch (movedPieceType)
+    {
+        case KNIGHT: return MoveTables::KNIGHT_MOVE_TABLE[fromSquare] & SquareToBitboard(toSquare);
+        case BISHOP: return MoveTables::GetBishopMoves(fromSquare, allOccupancyBitboard) & SquareToBitboard(toSquare);
+        case ROOK:   return MoveTables::GetRookMoves(fromSquare, allOccupancyBitboard) & SquareToBitboard(toSquare);
+        case QUEEN:  return MoveTables::GetQueenMoves(fromSquare, allOccupancyBitboard) & SquareToBitboard(toSquare);
+        default:     return MoveTables::KING_MOVE_TABLE[fromSquare] & SquareToBitboard(toSquare);
+    }
+}
+
+bool Position::IsLegal(Move move) const
+{
+    Square fromSquare = move.GetFromSquare();
+    Square toSquare = move.GetToSquare();
+    Move::MoveFlag moveFlag = move.GetFlag();
+
+    Colour enemyColour = ~activeColour;
+    Square kingSquare = GetKingSquare(activeColour);
+    Bitboard checkersBitboard = GetCheckersBitboard();
+
+    if (fromSquare == kingSquare)
+    {
+        if (moveFlag == Move::KING_CASTLE || moveFlag == Move::QUEEN_CASTLE)
+        {
+            Square transitSquare = moveFlag == Move::KING_CASTLE ? fromSquare + EAST : fromSquare + WEST;
+
+            return !checkersBitboard &&
+                   !GetAttackersToSquare(transitSquare, enemyColour, allOccupancyBitboard) &&
+                   !GetAttackersToSquare(toSquare, enemyColour, allOccupancyBitboard);
+        }
+
+        // The king is taken off the board so that it does not hide the square behind it from a
+        // slider that is checking it.
+        return !GetAttackersToSquare(toSquare, enemyColour, allOccupancyBitboard ^ SquareToBitboard(kingSquare));
+    }
+
+    // Two pieces leave the board at once, which no pin covers, so the king is looked at directly.
+    if (moveFlag == Move::EN_PASSANT_CAPTURE)
+    {
+        Bitboard capturedPawnBitboard = SquareToBitboard(toSquare - (activeColour == WHITE ? NORTH : SOUTH));
+        Bitboard occupancyBitboard = (allOccupancyBitboard ^ SquareToBitboard(fromSquare) ^ capturedPawnBitboard) |
+                                     SquareToBitboard(toSquare);
+
+        return !(GetAttackersToSquare(kingSquare, enemyColour, occupancyBitboard) & (~capturedPawnBitboard));
+    }
+
+    if (checkersBitboard)
+    {
+        // Only the king can answer a double check.
+        if (BB::CountBits(checkersBitboard) > 1)
+        {
+            return false;
+        }
+
+        Square checkerSquare = Square(BB::GetLSB(checkersBitboard));
+
+        if (!((MoveTables::BETWEEN_TABLE[kingSquare][checkerSquare] | checkersBitboard) & SquareToBitboard(toSquare)))
+        {
+            return false;
+        }
+    }
+
+    // A pinned piece may only move along the line of its pin.
+    return !(GetBlockersForKingBitboard(activeColour) & SquareToBitboard(fromSquare)) ||
+           (MoveTables::LINE_TABLE[kingSquare][fromSquare] & SquareToBitboard(toSquare));
+}
+
 bool Position::IsRepetition(int searchPly) const
 {
-    const int maximumLookback = std::min(halfMoveClock, int(hashKeyHistory.size()));
+    const HashKey hashKey = states[stateIndex].hashKey;
+    const int maximumLookback = std::min(states[stateIndex].halfMoveClock, int(stateIndex));
 
     int repetitionCount = 0;
 
     for (int lookback = 2; lookback <= maximumLookback; lookback += 2)
     {
-        if (hashKeyHistory[hashKeyHistory.size() - size_t(lookback)] != hashKey)
+        if (states[stateIndex - size_t(lookback)].hashKey != hashKey)
         {
             continue;
         }
@@ -255,6 +656,12 @@ bool Position::IsRepetition(int searchPly) const
     return false;
 }
 
+bool Position::HasNonPawnMaterial(Colour colour) const
+{
+    return GetOccupancyBitboard(colour) & ~(GetPieceBitboard(MakePiece(colour, PAWN)) |
+                                            GetPieceBitboard(MakePiece(colour, KING)));
+}
+
 std::string Position::ToString(bool whitePOV) const
 {
     static const std::string rankSpacing = "+---+---+---+---+---+---+---+---+\n";
@@ -308,12 +715,13 @@ void Position::Clear()
     colourOccupancyBitboards.fill(0ULL);
     allOccupancyBitboard = 0ULL;
     activeColour = WHITE;
-    castlingRights = NO_CASTLING_RIGHTS;
-    enPassantTargetSquare = NO_SQUARE;
-    halfMoveClock = 0;
     fullMoveNumber = 1;
-    hashKey = 0ULL;
-    hashKeyHistory.clear();
+
+    stateIndex = 0;
+    states[0] = StateInfo();
+    states[0].castlingRights = NO_CASTLING_RIGHTS;
+    states[0].enPassantTargetSquare = NO_SQUARE;
+    states[0].capturedPiece = NO_PIECE;
 }
 
 void Position::SetSquare(Square square, Piece piece)
@@ -323,8 +731,6 @@ void Position::SetSquare(Square square, Piece piece)
     BB::SetSquare(pieceBitboards[PieceToBitboardIndex(piece)], square);
     BB::SetSquare(colourOccupancyBitboards[GetColour(piece)], square);
     BB::SetSquare(allOccupancyBitboard, square);
-
-    hashKey ^= Zobrist::KEYS.pieceSquareKeys[PieceToBitboardIndex(piece)][square];
 }
 
 void Position::ClearSquare(Square square)
@@ -337,8 +743,6 @@ void Position::ClearSquare(Square square)
     allOccupancyBitboard &= ~squareBitboard;
 
     squares[square] = NO_PIECE;
-
-    hashKey ^= Zobrist::KEYS.pieceSquareKeys[PieceToBitboardIndex(piece)][square];
 }
 
 // !EXPLAIN!
@@ -353,25 +757,159 @@ void Position::MovePiece(Square fromSquare, Square toSquare)
 
     squares[fromSquare] = NO_PIECE;
     squares[toSquare] = piece;
+}
+
+// The material key takes the piece as the last of its kind, counting itself, so it must be called
+// after the piece is put on the board and before it is taken off.
+void Position::UpdateKeysWithPiece(Square square)
+{
+    StateInfo& state = states[stateIndex];
+
+    Piece piece = squares[square];
+    size_t pieceIndex = PieceToBitboardIndex(piece);
+
+    state.hashKey ^= Zobrist::KEYS.pieceSquareKeys[pieceIndex][square];
+
+    if (GetType(piece) == PAWN)
+    {
+        state.pawnKey ^= Zobrist::KEYS.pieceSquareKeys[pieceIndex][square];
+    }
 
-    hashKey ^= Zobrist::KEYS.pieceSquareKeys[PieceToBitboardIndex(piece)][fromSquare] ^
-               Zobrist::KEYS.pieceSquareKeys[PieceToBitboardIndex(piece)][toSquare];
+    const size_t pieceCount = size_t(BB::CountBits(pieceBitboards[pieceIndex]));
+
+    state.materialKey ^= Zobrist::KEYS.pieceSquareKeys[pieceIndex][pieceCount - 1U];
+}
+
+// Called once the piece is on its to square.
+void Position::UpdateKeysWithPieceMove(Square fromSquare, Square toSquare)
+{
+    StateInfo& state = states[stateIndex];
+
+    Piece piece = squares[toSquare];
+    size_t pieceIndex = PieceToBitboardIndex(piece);
+
+    HashKey moveKey = Zobrist::KEYS.pieceSquareKeys[pieceIndex][fromSquare] ^
+                      Zobrist::KEYS.pieceSquareKeys[pieceIndex][toSquare];
+
+    state.hashKey ^= moveKey;
+
+    if (GetType(piece) == PAWN)
+    {
+        state.pawnKey ^= moveKey;
+    }
 }
 
 // !EXPLAIN!
 void Position::UpdateHashKeyWithState()
 {
-    hashKey ^= Zobrist::KEYS.castlingRightKeys[castlingRights];
+    StateInfo& state = states[stateIndex];
+
+    state.hashKey ^= Zobrist::KEYS.castlingRightKeys[state.castlingRights];
 
-    if (enPassantTargetSquare != NO_SQUARE)
+    if (state.enPassantTargetSquare != NO_SQUARE)
     {
-        hashKey ^= Zobrist::KEYS.enPassantFileKeys[SquareToFile(enPassantTargetSquare)];
+        state.hashKey ^= Zobrist::KEYS.enPassantFileKeys[SquareToFile(state.enPassantTargetSquare)];
     }
 
     if (activeColour == BLACK)
     {
-        hashKey ^= Zobrist::KEYS.sideToMoveKey;
+        state.hashKey ^= Zobrist::KEYS.sideToMoveKey;
     }
 }
 
+void Position::UpdateCheckInfo()
+{
+    StateInfo& state = states[stateIndex];
+
+    Colour enemyColour = ~activeColour;
+
+    Square kingSquare = GetKingSquare(activeColour);
+    Square enemyKingSquare = GetKingSquare(enemyColour);
+
+    state.checkersBitboard = GetAttackersToSquare(kingSquare, enemyColour, allOccupancyBitboard);
+
+    state.blockersForKingBitboards[activeColour] =
+        FindSliderBlockers(kingSquare, enemyColour, state.pinnersBitboards[enemyColour]);
+    state.blockersForKingBitboards[enemyColour] =
+        FindSliderBlockers(enemyKingSquare, activeColour, state.pinnersBitboards[activeColour]);
+
+    Bitboard bishopCheckSquaresBitboard = MoveTables::GetBishopMoves(enemyKingSquare, allOccupancyBitboard);
+    Bitboard rookCheckSquaresBitboard = MoveTables::GetRookMoves(enemyKingSquare, allOccupancyBitboard);
+
+    // A pawn gives check from where an enemy pawn on the king's square would attack.
+    state.checkSquaresBitboards[PieceTypeToIndex(PAWN)]   = MoveTables::PAWN_ATTACK_TABLE[enemyColour][enemyKingSquare];
+    state.checkSquaresBitboards[PieceTypeToIndex(KNIGHT)] = MoveTables::KNIGHT_MOVE_TABLE[enemyKingSquare];
+    state.checkSquaresBitboards[PieceTypeToIndex(BISHOP)] = bishopCheckSquaresBitboard;
+    state.checkSquaresBitboards[PieceTypeToIndex(ROOK)]   = rookCheckSquaresBitboard;
+    state.checkSquaresBitboards[PieceTypeToIndex(QUEEN)]  = bishopCheckSquaresBitboard | rookCheckSquaresBitboard;
+    state.checkSquaresBitboards[PieceTypeToIndex(KING)]   = 0ULL;
+}
+
+Bitboard Position::FindSliderBlockers(Square kingSquare, Colour sliderColour, Bitboard& pinnersBitboard) const
+{
+    Bitboard queenBitboard = GetPieceBitboard(MakePiece(sliderColour, QUEEN));
+
+    Bitboard bishopsAndQueensBitboard = GetPieceBitboard(MakePiece(sliderColour, BISHOP)) | queenBitboard;
+    Bitboard rooksAndQueensBitboard = GetPieceBitboard(MakePiece(sliderColour, ROOK)) | queenBitboard;
+
+    // The sliders that would attack the king on an empty board.
+    Bitboard snipersBitboard = (MoveTables::GetBishopMoves(kingSquare, 0ULL) & bishopsAndQueensBitboard) |
+                               (MoveTables::GetRookMoves(kingSquare, 0ULL) & rooksAndQueensBitboard);
+
+    Bitboard kingColourBitboard = GetOccupancyBitboard(~sliderColour);
+
+    Bitboard blockersBitboard = 0ULL;
+    pinnersBitboard = 0ULL;
+
+    while (snipersBitboard)
+    {
+        Square sniperSquare = Square(BB::PopLSB(snipersBitboard));
+        Bitboard betweenBitboard = MoveTables::BETWEEN_TABLE[kingSquare][sniperSquare] & allOccupancyBitboard;
+
+        if (BB::CountBits(betweenBitboard) == 1)
+        {
+            blockersBitboard |= betweenBitboard;
+
+            if (betweenBitboard & kingColourBitboard)
+            {
+                pinnersBitboard |= SquareToBitboard(sniperSquare);
+            }
+        }
+    }
+
+    return blockersBitboard;
+}
+
+// The old state is left as it was to go back to. The check information is not carried over, as
+// every move works it out afresh.
+StateInfo& Position::PushState()
+{
+    if (stateIndex + 1U == states.size())
+    {
+        DiscardOldStates();
+    }
+
+    const StateInfo& previousState = states[stateIndex];
+    StateInfo& state = states[++stateIndex];
+
+    state.hashKey = previousState.hashKey;
+    state.pawnKey = previousState.pawnKey;
+    state.materialKey = previousState.materialKey;
+    state.castlingRights = previousState.castlingRights;
+    state.enPassantTargetSquare = previousState.enPassantTargetSquare;
+    state.halfMoveClock = previousState.halfMoveClock;
+
+    return state;
+}
+
+// Only reached in games far longer than any real one, so the copy does not need to be quick.
+void Position::DiscardOldStates()
+{
+    const size_t keptStateCount = states.size() / 2U;
+
+    std::copy(states.end() - std::ptrdiff_t(keptStateCount), states.end(), states.begin());
+
+    stateIndex = keptStateCount - 1U;
+}
+
 } // namespace Gluon
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bitboard.h"
 #include "types.h"
 #include "move.h"
 
@@ -7,20 +8,48 @@
 #include <string>
 #include <ostream>
 #include <cassert>
-#include <vector>
 
 namespace Gluon {
 
-// State that a move destroys and so cannot be recovered from the move alone.
-struct PositionState
+// Enough for any game and the search on top of it, as only the states back to the last capture or
+// pawn move are kept once it fills up.
+constexpr size_t MAX_STATE_PLIES = 1024U;
+
+// What a move destroys and so cannot be recovered from the move alone, along with what is cheaper
+// to keep than to work out again. There is one for every ply played, so a move is unmade by going
+// back to the one before.
+struct StateInfo
 {
-    Piece capturedPiece;
+    HashKey hashKey;
+
+    // Covers only the pawns, for tables of pawn structure.
+    HashKey pawnKey;
+
+    // Covers only how many of each piece there are, for tables of material balance.
+    HashKey materialKey;
 
     CastlingRight castlingRights;
 
     Square enPassantTargetSquare;
 
     int halfMoveClock;
+
+    // The piece taken by the move that led here.
+    Piece capturedPiece;
+
+    // The rest is worked out afresh after every move, for move generation and check detection.
+    // The pieces giving check to the side to move.
+    Bitboard checkersBitboard;
+
+    // By the colour of the king: the pieces of either colour that alone stand between it and an
+    // enemy slider. The king's own are pinned, while moving the enemy's gives a discovered check.
+    std::array<Bitboard, NUM_COLOURS> blockersForKingBitboards;
+
+    // By colour: the sliders that pin a piece to the enemy king.
+    std::array<Bitboard, NUM_COLOURS> pinnersBitboards;
+
+    // By piece type: the squares from which a piece of the side to move would give check.
+    std::array<Bitboard, NUM_PIECE_TYPES> checkSquaresBitboards;
 };
 
 class Position
@@ -32,14 +61,71 @@ public:
     // [ Public methods ]
     void SetupWithFEN(const std::string& fen);
 
-    void MakeMove(Move move, PositionState& state);
+    void MakeMove(Move move);
+
+    void UnmakeMove(Move move);
+
+    // Passes the turn to the other side without moving a piece, for null move pruning.
+    void MakeNullMove();
+
+    void UnmakeNullMove();
+
+    inline bool IsInCheck() const
+    {
+        return states[stateIndex].checkersBitboard != 0ULL;
+    }
+
+    inline Bitboard GetCheckersBitboard() const
+    {
+        return states[stateIndex].checkersBitboard;
+    }
+
+    inline Bitboard GetBlockersForKingBitboard(Colour kingColour) const
+    {
+        return states[stateIndex].blockersForKingBitboards[kingColour];
+    }
+
+    inline Bitboard GetPinnersBitboard(Colour pinnerColour) const
+    {
+        return states[stateIndex].pinnersBitboards[pinnerColour];
+    }
+
+    inline Bitboard GetCheckSquaresBitboard(PieceType pieceType) const
+    {
+        return states[stateIndex].checkSquaresBitboards[PieceTypeToIndex(pieceType)];
+    }
+
+    inline Square GetKingSquare(Colour colour) const
+    {
+        return Square(BB::GetLSB(GetPieceBitboard(MakePiece(colour, KING))));
+    }
+
+    // Sliders look through the given occupancy rather than the board's, so that attackers hidden
+    // behind pieces that have been taken away can be found.
+    Bitboard GetAttackersToSquare(Square square, Colour attackerColour, Bitboard occupancyBitboard) const;
 
-    void UnmakeMove(Move move, const PositionState& state);
+    // Static exchange evaluation: tells whether the captures on the move's to square, starting with
+    // the move, win at least the threshold when each side always recaptures with its least
+    // valuable piece and may stop whenever carrying on would lose. Pins are not taken into account.
+    bool SEE(Move move, int threshold) const;
 
-    bool IsInCheck() const;
+    // Tells whether the move, which must be legal, would put the enemy king in check, without
+    // making it.
+    bool GivesCheck(Move move) const;
+
+    // Tells whether the move, which may have come from anywhere, is one that the pieces on the board
+    // could make, leaving aside whether it leaves the king in check.
+    bool IsPseudoLegal(Move move) const;
+
+    // Tells whether a pseudo-legal move leaves the king out of check.
+    bool IsLegal(Move move) const;
 
     bool IsRepetition(int searchPly) const;
 
+    // Tells whether the colour has any piece besides pawns and its king, without which zugzwang
+    // is common enough that passing the turn stops being a safe guess at a lower bound.
+    bool HasNonPawnMaterial(Colour colour) const;
+
     std::string ToString(bool whitePOV = true) const;
 
     inline Colour GetActiveColour() const
@@ -47,6 +133,11 @@ public:
         return activeColour;
     }
 
+    inline Piece GetPiece(Square square) const
+    {
+        return squares[square];
+    }
+
     inline Bitboard GetPieceBitboard(Piece piece) const
     {
         return pieceBitboards[PieceToBitboardIndex(piece)];
@@ -64,22 +155,32 @@ public:
 
     inline Square GetEnPassantTargetSquare() const
     {
-        return enPassantTargetSquare;
+        return states[stateIndex].enPassantTargetSquare;
     }
 
     inline CastlingRight GetCastlingRights() const
     {
-        return castlingRights;
+        return states[stateIndex].castlingRights;
     }
 
     inline int GetHalfMoveClock() const
     {
-        return halfMoveClock;
+        return states[stateIndex].halfMoveClock;
     }
 
     inline HashKey GetHashKey() const
     {
-        return hashKey;
+        return states[stateIndex].hashKey;
+    }
+
+    inline HashKey GetPawnKey() const
+    {
+        return states[stateIndex].pawnKey;
+    }
+
+    inline HashKey GetMaterialKey() const
+    {
+        return states[stateIndex].materialKey;
     }
 
 private:
@@ -108,9 +209,28 @@ private:
 
     void MovePiece(Square fromSquare, Square toSquare);
 
+    // Folds the piece on the square into the keys, or takes it out of them if it is already in.
+    void UpdateKeysWithPiece(Square square);
+
+    void UpdateKeysWithPieceMove(Square fromSquare, Square toSquare);
+
     // Folds the state that the piece placement alone does not cover into the hash key.
     void UpdateHashKeyWithState();
 
+    // Fills in the check information of the current state.
+    void UpdateCheckInfo();
+
+    // The pieces that alone stand between the king and a slider of the given colour, and those of
+    // the sliders that pin a piece of the king's own colour.
+    Bitboard FindSliderBlockers(Square kingSquare, Colour sliderColour, Bitboard& pinnersBitboard) const;
+
+    // Moves on to a new state, starting from what carries over from the current one.
+    StateInfo& PushState();
+
+    // Makes room for a new state by dropping the oldest, keeping enough of the newest for any
+    // search to unmake its moves and for repetitions to be found.
+    void DiscardOldStates();
+
     // [ Data members ]
     std::array<Piece, NUM_SQUARES> squares;
     std::array<Bitboard, NUM_PIECES> pieceBitboards;
@@ -119,18 +239,12 @@ private:
 
     Colour activeColour;
 
-    CastlingRight castlingRights;
-
-    Square enPassantTargetSquare;
-
-    int halfMoveClock;
-
     int fullMoveNumber;
 
-    HashKey hashKey;
+    // The current state is the one at the index, with those of the plies before it below.
+    std::array<StateInfo, MAX_STATE_PLIES> states;
 
-    // !EXPLAIN!
-    std::vector<HashKey> hashKeyHistory;
+    size_t stateIndex;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const Position& position)
@@ -5,6 +5,8 @@
 #include "movelist.h"
 
 #include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace Gluon {
 
@@ -13,60 +15,204 @@ static constexpr int MAX_QUIESCENCE_PLY = 32;
 
 static constexpr int HALF_MOVE_CLOCK_DRAW_LIMIT = 100;
 
-static constexpr uint64_t TIME_CHECK_NODE_INTERVAL = 2048;
-
 static constexpr int64_t MOVE_OVERHEAD_MILLISECONDS = 50;
 
 static constexpr int64_t DEFAULT_MOVES_TO_GO = 30;
 
-// !EXPLAIN!
-static int64_t CalculateTimeBudget(const SearchLimits& limits, Colour activeColour)
+// [ Time management ]
+// How far past the soft limit the hard limit lets an iteration run before it is abandoned.
+static constexpr int64_t HARD_TIME_LIMIT_FACTOR = 5;
+
+// The hard limit never takes more than this share of the remaining clock.
+static constexpr int64_t HARD_TIME_LIMIT_CLOCK_DIVISOR = 2;
+
+// Scales the soft limit by how many iterations in a row have kept the same best move.
+static constexpr std::array<double, 5> BEST_MOVE_STABILITY_SCALES = { 1.8, 1.3, 1.0, 0.85, 0.75 };
+
+// A score that fell since the last iteration buys time to find a way out, a centipawn at a time.
+static constexpr int MAX_SCORE_DROP = 60;
+
+static constexpr double SCORE_DROP_SCALE_PER_CENTIPAWN = 0.01;
+
+// Less the share of the iteration's nodes spent on the best move: the more the other moves took,
+// the closer they came to replacing it.
+static constexpr double BEST_MOVE_NODES_SCALE_BASE = 1.6;
+
+// Shallow iterations are too unstable for a narrow window to pay off.
+static constexpr int ASPIRATION_MIN_DEPTH = 4;
+
+static constexpr int ASPIRATION_INITIAL_DELTA = 25;
+
+// History scores stay within this bound, so old cut-offs count for less as new ones come in.
+static constexpr int MAX_HISTORY_SCORE = 16384;
+
+static constexpr int MAX_HISTORY_BONUS = 1200;
+
+// [ Null move pruning ]
+static constexpr int NULL_MOVE_MIN_DEPTH = 3;
+
+static constexpr int NULL_MOVE_BASE_REDUCTION = 3;
+
+// The reduction grows by a ply for every this many plies of depth...
+static constexpr int NULL_MOVE_DEPTH_DIVISOR = 6;
+
+// ...and for every this much the static evaluation is above beta, up to a limit.
+static constexpr int NULL_MOVE_EVALUATION_DIVISOR = 200;
+
+static constexpr int NULL_MOVE_MAX_EVALUATION_REDUCTION = 3;
+
+// Deep enough that a wrong cut-off is costly, so it is checked with a normal search first.
+static constexpr int NULL_MOVE_VERIFICATION_MIN_DEPTH = 12;
+
+// [ Late move reductions and pruning ]
+static constexpr int LATE_MOVE_REDUCTION_MIN_DEPTH = 3;
+
+// Moves up to this one in the ordering are always searched to full depth.
+static constexpr size_t LATE_MOVE_REDUCTION_MIN_MOVE_COUNT = 3;
+
+static constexpr size_t LATE_MOVE_REDUCTION_TABLE_SIZE = 64;
+
+static constexpr double LATE_MOVE_REDUCTION_BASE = 0.75;
+
+static constexpr double LATE_MOVE_REDUCTION_DIVISOR = 2.25;
+
+static constexpr int LATE_MOVE_PRUNING_MAX_DEPTH = 3;
+
+static constexpr size_t LATE_MOVE_PRUNING_BASE_MOVE_COUNT = 3;
+
+// [ Static exchange pruning ]
+static constexpr int SEE_PRUNING_MAX_DEPTH = 6;
+
+// Material a capture may lose per ply of depth left before it is pruned.
+static constexpr int SEE_PRUNING_MARGIN_PER_DEPTH = 100;
+
+// Reductions grow with both the depth left and how late the move comes, but only logarithmically,
+// so that no move is ever cut down to nothing.
+static const auto LATE_MOVE_REDUCTION_TABLE = []()
+{
+    std::array<std::array<int, LATE_MOVE_REDUCTION_TABLE_SIZE>, LATE_MOVE_REDUCTION_TABLE_SIZE> reductionTable{};
+
+    for (size_t depth = 1; depth < LATE_MOVE_REDUCTION_TABLE_SIZE; ++depth)
+    {
+        for (size_t moveCount = 1; moveCount < LATE_MOVE_REDUCTION_TABLE_SIZE; ++moveCount)
+        {
+            reductionTable[depth][moveCount] = int(LATE_MOVE_REDUCTION_BASE +
+                                                   std::log(double(depth)) * std::log(double(moveCount)) /
+                                                   LATE_MOVE_REDUCTION_DIVISOR);
+        }
+    }
+
+    return reductionTable;
+}();
+
+static void UpdatePrincipalVariation(PrincipalVariation& principalVariation, Move move,
+                                     const PrincipalVariation& childPrincipalVariation)
 {
+    principalVariation.moves[0] = move;
+    principalVariation.length = std::min(childPrincipalVariation.length + 1U,
+                                          principalVariation.moves.size());
+
+    std::copy_n(childPrincipalVariation.moves.begin(), principalVariation.length - 1U,
+                principalVariation.moves.begin() + 1);
+}
+
+static int GetLateMoveReduction(int depth, size_t moveCount)
+{
+    return LATE_MOVE_REDUCTION_TABLE[std::min(size_t(depth), LATE_MOVE_REDUCTION_TABLE_SIZE - 1U)]
+                                    [std::min(moveCount, LATE_MOVE_REDUCTION_TABLE_SIZE - 1U)];
+}
+
+// The closer a score already is to the bound, the less a bonus in the same direction moves it.
+static void UpdateHistoryScore(int& historyScore, int bonus)
+{
+    historyScore += bonus - historyScore * (bonus < 0 ? -bonus : bonus) / MAX_HISTORY_SCORE;
+}
+
+// The soft limit is the time the search would like to take, checked between iterations and scaled
+// by how settled the search looks. The hard limit only guards against running out of time.
+static void CalculateTimeLimits(const SearchLimits& limits, Colour activeColour,
+                                int64_t& softLimitMilliseconds, int64_t& hardLimitMilliseconds)
+{
+    softLimitMilliseconds = NO_TIME_LIMIT;
+    hardLimitMilliseconds = NO_TIME_LIMIT;
+
     if (limits.infinite)
     {
-        return NO_TIME_LIMIT;
+        return;
     }
 
+    // A fixed move time is used in full, so there is nothing for a soft limit to save.
     if (limits.moveTimeMilliseconds != NO_TIME_LIMIT)
     {
-        return limits.moveTimeMilliseconds;
+        hardLimitMilliseconds = limits.moveTimeMilliseconds;
+
+        return;
     }
 
     const int64_t remainingTime = limits.remainingTimeMilliseconds[activeColour];
 
     if (remainingTime == NO_TIME_LIMIT)
     {
-        return NO_TIME_LIMIT;
+        return;
     }
 
+    // !EXPLAIN!
+    const int64_t availableTime = std::max(int64_t(1), remainingTime - MOVE_OVERHEAD_MILLISECONDS);
     const int64_t movesToGo = limits.movesToGo > 0 ? int64_t(limits.movesToGo) : DEFAULT_MOVES_TO_GO;
-    const int64_t budget = remainingTime / movesToGo + limits.incrementMilliseconds[activeColour] / 2;
 
-    return std::max(int64_t(1), std::min(budget, remainingTime - MOVE_OVERHEAD_MILLISECONDS));
+    softLimitMilliseconds = std::clamp(remainingTime / movesToGo + limits.incrementMilliseconds[activeColour] / 2,
+                                       int64_t(1), availableTime);
+
+    hardLimitMilliseconds = std::max(softLimitMilliseconds,
+                                     std::min(softLimitMilliseconds * HARD_TIME_LIMIT_FACTOR,
+                                              availableTime / HARD_TIME_LIMIT_CLOCK_DIVISOR));
+}
+
+static double GetSoftTimeLimitScale(int bestMoveStability, int scoreDrop, double bestMoveNodeFraction)
+{
+    const double stabilityScale = BEST_MOVE_STABILITY_SCALES[std::min(size_t(bestMoveStability),
+                                                                      BEST_MOVE_STABILITY_SCALES.size() - 1U)];
+    const double scoreDropScale = 1.0 + SCORE_DROP_SCALE_PER_CENTIPAWN * std::clamp(scoreDrop, 0, MAX_SCORE_DROP);
+    const double bestMoveNodesScale = BEST_MOVE_NODES_SCALE_BASE - std::clamp(bestMoveNodeFraction, 0.0, 1.0);
+
+    return stabilityScale * scoreDropScale * bestMoveNodesScale;
 }
 
 // [ Constructors ]
-Searcher::Searcher()
+Searcher::Searcher(TranspositionTable& sharedTranspositionTable, size_t searchThreadIndex)
     : stopRequested(false),
       stopped(false),
       nodes(0),
-      timeBudgetMilliseconds(NO_TIME_LIMIT),
-      startTime(std::chrono::steady_clock::now()) {}
+      rootBestMoveNodes(0),
+      isFollowingPrincipalVariation(false),
+      nullMoveMinPly(0),
+      softTimeLimitMilliseconds(NO_TIME_LIMIT),
+      hardTimeLimitMilliseconds(NO_TIME_LIMIT),
+      startTime(std::chrono::steady_clock::now()),
+      transpositionTable(sharedTranspositionTable),
+      threadIndex(searchThreadIndex)
+{
+    ClearHeuristics();
+}
 
 // [ Public methods ]
-SearchResult Searcher::Run(Position& position, const SearchLimits& limits, SearchReportCallback report)
+SearchResult Searcher::Run(Position& position, const SearchLimits& limits,
+                           const SearchReportCallback& report)
 {
     searchLimits = limits;
-    stopRequested = false;
     stopped = false;
-    nodes = 0;
+    nullMoveMinPly = 0;
     rootBestMove = Move();
+    previousPrincipalVariation = PrincipalVariation();
+
+    AgeHeuristics();
     startTime = std::chrono::steady_clock::now();
-    timeBudgetMilliseconds = CalculateTimeBudget(limits, position.GetActiveColour());
+    CalculateTimeLimits(limits, position.GetActiveColour(), softTimeLimitMilliseconds, hardTimeLimitMilliseconds);
 
     SearchResult result;
 
-    const MoveList rootMoves = GenerateLegalMoves(position);
+    const MoveList rootMoves = searchLimits.searchMoves.Size() > 0 ? searchLimits.searchMoves
+                                                                    : GenerateLegalMoves(position);
 
     if (rootMoves.Size() == 0)
     {
@@ -76,11 +222,63 @@ SearchResult Searcher::Run(Position& position, const SearchLimits& limits, Searc
     // Always have something to play, even if the first iteration is cut short.
     result.bestMove = rootMoves[0];
 
+    if (hardTimeLimitMilliseconds != NO_TIME_LIMIT)
+    {
+        stopTimer.Start(stopRequested, hardTimeLimitMilliseconds);
+    }
+
     const int maxDepth = std::min(searchLimits.depth, MAX_SEARCH_DEPTH);
 
-    for (int depth = 1; depth <= maxDepth; ++depth)
+    // Helper threads on odd indices skip the first iteration, so that they spread out over
+    // different depths instead of walking the same tree in step with the main thread.
+    const int startDepth = std::min(1 + int(threadIndex % 2), maxDepth);
+
+    int bestMoveStability = 0;
+
+    const size_t multiPV = std::clamp(searchLimits.multiPV, MIN_MULTI_PV, rootMoves.Size());
+
+    // The lines of the last completed iteration, best first.
+    std::vector<SearchResult> lines(multiPV);
+
+    for (int depth = startDepth; depth <= maxDepth; ++depth)
     {
-        const int score = Negamax(position, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+        const uint64_t iterationStartNodes = GetNodes();
+
+        std::vector<SearchResult> iterationLines(multiPV);
+
+        uint64_t bestLineNodes = 0;
+        uint64_t bestLineMoveNodes = 0;
+
+        // Each line searches the root without the moves of the lines before it, so that it finds
+        // the next best move. The lines share the table and the move ordering, so the later lines
+        // cost far less than the first.
+        excludedRootMoves = MoveList();
+
+        for (size_t lineIndex = 0; lineIndex < multiPV; ++lineIndex)
+        {
+            previousPrincipalVariation = lines[lineIndex].principalVariation;
+
+            const int score = AspirationSearch(position, depth, lines[lineIndex].score);
+
+            if (stopped)
+            {
+                break;
+            }
+
+            SearchResult& line = iterationLines[lineIndex];
+            line.bestMove = rootBestMove;
+            line.principalVariation = searchStack[0].principalVariation;
+            line.score = score;
+            line.depth = depth;
+
+            if (lineIndex == 0)
+            {
+                bestLineNodes = GetNodes() - iterationStartNodes;
+                bestLineMoveNodes = rootBestMoveNodes;
+            }
+
+            excludedRootMoves.AddMove(rootBestMove);
+        }
 
         // !EXPLAIN!
         if (stopped)
@@ -88,20 +286,66 @@ SearchResult Searcher::Run(Position& position, const SearchLimits& limits, Searc
             break;
         }
 
-        result.bestMove = rootBestMove;
-        result.score = score;
-        result.depth = depth;
-        result.nodes = nodes;
-        result.timeMilliseconds = GetElapsedMilliseconds();
-        result.hashFull = transpositionTable.GetHashFull();
+        // A later line can still come out ahead of an earlier one once it has been searched in full.
+        std::stable_sort(iterationLines.begin(), iterationLines.end(),
+                         [](const SearchResult& firstLine, const SearchResult& secondLine)
+                         {
+                             return firstLine.score > secondLine.score;
+                         });
+
+        bestMoveStability = result.depth > 0 && iterationLines[0].bestMove == result.bestMove
+                            ? bestMoveStability + 1 : 0;
+
+        const int scoreDrop = result.depth > 0 ? result.score - iterationLines[0].score : 0;
+
+        lines = iterationLines;
+
+        for (size_t lineIndex = 0; lineIndex < multiPV; ++lineIndex)
+        {
+            SearchResult& line = lines[lineIndex];
+            line.nodes = GetNodes();
+            line.timeMilliseconds = GetElapsedMilliseconds();
+            line.hashFull = transpositionTable.GetHashFull();
+            line.multiPV = lineIndex + 1U;
+
+            if (report != nullptr)
+            {
+                report(line);
+            }
+        }
+
+        result = lines[0];
 
-        if (report != nullptr)
+        if (searchLimits.mate > 0 && result.score >= MATE_SCORE - MAX_MATE_PLIES &&
+            MateScoreToMoves(result.score) <= searchLimits.mate)
         {
-            report(result);
+            break;
+        }
+
+        // Another iteration is only started while the soft limit, scaled for how settled the best
+        // move looks, has not been used up. Time spent pondering is not on the clock.
+        if (softTimeLimitMilliseconds != NO_TIME_LIMIT && !stopTimer.IsPondering())
+        {
+            const double softTimeLimitScale = GetSoftTimeLimitScale(bestMoveStability, scoreDrop,
+                                                                    double(bestLineMoveNodes) /
+                                                                    double(std::max(bestLineNodes, uint64_t(1))));
+
+            const int64_t scaledSoftTimeLimit = std::min(int64_t(double(softTimeLimitMilliseconds) * softTimeLimitScale),
+                                                         hardTimeLimitMilliseconds);
+
+            if (stopTimer.GetClockMilliseconds() >= scaledSoftTimeLimit)
+            {
+                break;
+            }
         }
     }
 
-    result.nodes = nodes;
+    // A move may not be given while pondering, even when the search has run out of depth.
+    stopTimer.WaitWhilePondering(stopRequested);
+
+    stopTimer.Cancel();
+
+    result.nodes = GetNodes();
     result.timeMilliseconds = GetElapsedMilliseconds();
 
     return result;
@@ -110,56 +354,166 @@ SearchResult Searcher::Run(Position& position, const SearchLimits& limits, Searc
 void Searcher::RequestStop()
 {
     stopRequested.store(true, std::memory_order_relaxed);
+
+    stopTimer.Notify();
 }
 
-void Searcher::ResizeTranspositionTable(size_t megabytes)
+void Searcher::ResetClock(bool pondering)
 {
-    transpositionTable.Resize(megabytes);
+    stopTimer.ResetClock(pondering);
 }
 
-void Searcher::ClearTranspositionTable()
+void Searcher::PonderHit()
 {
-    transpositionTable.Clear();
+    stopTimer.PonderHit();
 }
 
-// [ Private methods ]
-// The stored move first, then captures and promotions, as they are the most likely to cause a cut-off.
-MoveList Searcher::OrderMoves(const MoveList& moves, Move hashMove)
+void Searcher::ClearStopRequest()
 {
-    MoveList orderedMoves;
+    stopRequested.store(false, std::memory_order_relaxed);
+}
 
-    // !EXPLAIN!
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+void Searcher::ClearHeuristics()
+{
+    counterMoves.fill(std::array<Move, NUM_SQUARES>());
+
+    for (SearchStackEntry& stackEntry : searchStack)
     {
-        if (moves[moveIndex] == hashMove)
+        stackEntry.killerMoves.fill(Move());
+        stackEntry.currentMove = Move();
+    }
+
+    for (auto& colourHistoryTable : historyTable)
+    {
+        for (auto& fromSquareHistoryTable : colourHistoryTable)
         {
-            orderedMoves.AddMove(moves[moveIndex]);
+            fromSquareHistoryTable.fill(0);
         }
     }
+}
 
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+void Searcher::ClearNodes()
+{
+    nodes.store(0, std::memory_order_relaxed);
+}
+
+// [ Private methods ]
+// Searches the root with a narrow window around the last iteration's score, which cuts off far more
+// of the tree, and widens the window on whichever side the score falls outside of it.
+int Searcher::AspirationSearch(Position& position, int depth, int previousScore)
+{
+    if (depth < ASPIRATION_MIN_DEPTH || IsMateScore(previousScore))
+    {
+        isFollowingPrincipalVariation = true;
+
+        return Negamax<ROOT_NODE>(position, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+    }
+
+    int delta = ASPIRATION_INITIAL_DELTA;
+    int alpha = std::max(previousScore - delta, -INFINITE_SCORE);
+    int beta = std::min(previousScore + delta, INFINITE_SCORE);
+
+    while (true)
     {
-        if ((moves[moveIndex].IsCapture() || moves[moveIndex].IsPromotion()) &&
-            !(moves[moveIndex] == hashMove))
+        isFollowingPrincipalVariation = true;
+
+        const int score = Negamax<ROOT_NODE>(position, depth, 0, alpha, beta);
+
+        if (stopped)
+        {
+            return score;
+        }
+
+        delta *= 2;
+
+        // A fail low also pulls beta down, as the true score is known to be below the old window.
+        if (score <= alpha)
+        {
+            beta = (alpha + beta) / 2;
+            alpha = std::max(score - delta, -INFINITE_SCORE);
+        }
+        else if (score >= beta)
+        {
+            beta = std::min(score + delta, INFINITE_SCORE);
+        }
+        else
         {
-            orderedMoves.AddMove(moves[moveIndex]);
+            return score;
         }
     }
+}
+
+void Searcher::UpdateQuietMoveHeuristics(const Position& position, int depth, int ply, Move move)
+{
+    KillerMoves& plyKillerMoves = searchStack[size_t(ply)].killerMoves;
 
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    if (!(plyKillerMoves[0] == move))
     {
-        if (!moves[moveIndex].IsCapture() && !moves[moveIndex].IsPromotion() &&
-            !(moves[moveIndex] == hashMove))
+        for (size_t killerIndex = NUM_KILLER_MOVES - 1U; killerIndex > 0; --killerIndex)
         {
-            orderedMoves.AddMove(moves[moveIndex]);
+            plyKillerMoves[killerIndex] = plyKillerMoves[killerIndex - 1U];
         }
+
+        plyKillerMoves[0] = move;
+    }
+
+    if (ply > 0 && !searchStack[size_t(ply - 1)].currentMove.IsNull())
+    {
+        const Move previousMove = searchStack[size_t(ply - 1)].currentMove;
+
+        counterMoves[previousMove.GetFromSquare()][previousMove.GetToSquare()] = move;
     }
 
-    return orderedMoves;
+    auto& colourHistoryTable = historyTable[position.GetActiveColour()];
+
+    const int bonus = std::min(depth * depth, MAX_HISTORY_BONUS);
+
+    const MoveList& failedQuietMoves = searchStack[size_t(ply)].failedQuietMoves;
+
+    UpdateHistoryScore(colourHistoryTable[move.GetFromSquare()][move.GetToSquare()], bonus);
+
+    for (size_t moveIndex = 0; moveIndex < failedQuietMoves.Size(); ++moveIndex)
+    {
+        const Move failedMove = failedQuietMoves[moveIndex];
+
+        UpdateHistoryScore(colourHistoryTable[failedMove.GetFromSquare()][failedMove.GetToSquare()], -bonus);
+    }
+}
+
+void Searcher::AgeHeuristics()
+{
+    for (SearchStackEntry& stackEntry : searchStack)
+    {
+        stackEntry.killerMoves.fill(Move());
+        stackEntry.currentMove = Move();
+    }
+
+    for (auto& colourHistoryTable : historyTable)
+    {
+        for (auto& fromSquareHistoryTable : colourHistoryTable)
+        {
+            for (int& historyScore : fromSquareHistoryTable)
+            {
+                historyScore /= 2;
+            }
+        }
+    }
 }
 
+template <NodeType nodeType>
 int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int beta)
 {
+    constexpr bool isRootNode = nodeType == ROOT_NODE;
+    constexpr bool isPVNode = nodeType != NON_PV_NODE;
+
+    SearchStackEntry& stackEntry = searchStack[size_t(ply)];
+
+    // Only a PV node keeps a line, so a non-PV one leaves it to its parent to clear.
+    if constexpr (isPVNode)
+    {
+        stackEntry.principalVariation.length = 0;
+    }
+
     if (ShouldStopSearch())
     {
         stopped = true;
@@ -168,19 +522,19 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
     }
 
     // !EXPLAIN!
-    if (ply > 0 && (position.IsRepetition(ply) ||
+    if (!isRootNode && (position.IsRepetition(ply) ||
                     (position.GetHalfMoveClock() >= HALF_MOVE_CLOCK_DRAW_LIMIT &&
-                     (!position.IsInCheck() || GenerateLegalMoves(position).Size() > 0))))
+                     (!position.IsInCheck() || HasLegalMove(position)))))
     {
         return DRAW_SCORE;
     }
 
     if (depth <= 0)
     {
-        return Quiescence(position, ply, alpha, beta);
+        return Quiescence<isPVNode ? PV_NODE : NON_PV_NODE>(position, ply, alpha, beta);
     }
 
-    ++nodes;
+    CountNode();
 
     const HashKey hashKey = position.GetHashKey();
     const int originalAlpha = alpha;
@@ -189,31 +543,183 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
     int storedScore = 0;
 
     // !EXPLAIN!
-    if (ply > 0 && transpositionTable.Probe(hashKey, depth, ply, alpha, beta, storedScore, hashMove))
+    if (!isRootNode && transpositionTable.Probe(hashKey, depth, ply, alpha, beta, storedScore, hashMove))
     {
         return storedScore;
     }
 
-    const MoveList moves = OrderMoves(GenerateLegalMoves(position), hashMove);
+    const bool isInCheck = position.IsInCheck();
 
-    // !EXPLAIN!
-    if (moves.Size() == 0)
+    if (!isInCheck)
+    {
+        stackEntry.staticEvaluation = Evaluate(position);
+    }
+
+    // If passing the turn still scores above beta, a real move almost surely would too, so a
+    // reduced search after a null move is enough to cut off. Not done twice in a row, nor where
+    // zugzwang is likely, as passing would then be better than any real move.
+    if (!isPVNode && !isInCheck && ply >= nullMoveMinPly && depth >= NULL_MOVE_MIN_DEPTH &&
+        !searchStack[size_t(ply - 1)].currentMove.IsNull() &&
+        position.HasNonPawnMaterial(position.GetActiveColour()))
+    {
+        if (stackEntry.staticEvaluation >= beta)
+        {
+            const int reduction = NULL_MOVE_BASE_REDUCTION + depth / NULL_MOVE_DEPTH_DIVISOR +
+                                  std::min((stackEntry.staticEvaluation - beta) / NULL_MOVE_EVALUATION_DIVISOR,
+                                           NULL_MOVE_MAX_EVALUATION_REDUCTION);
+
+            stackEntry.currentMove = Move();
+
+            position.MakeNullMove();
+
+            int nullMoveScore = -Negamax<NON_PV_NODE>(position, depth - 1 - reduction, ply + 1, -beta, -beta + 1);
+
+            position.UnmakeNullMove();
+
+            if (stopped)
+            {
+                return DRAW_SCORE;
+            }
+
+            if (nullMoveScore >= beta)
+            {
+                // A pass proves nothing about mate, so the bound is not trusted that far.
+                if (IsMateScore(nullMoveScore))
+                {
+                    nullMoveScore = beta;
+                }
+
+                if (depth < NULL_MOVE_VERIFICATION_MIN_DEPTH || nullMoveMinPly > 0)
+                {
+                    return nullMoveScore;
+                }
+
+                // The verification is a normal search of this node with null moves kept out of the
+                // top of its tree, where they would only repeat the cut-off being checked.
+                nullMoveMinPly = ply + 3 * (depth - reduction) / 4;
+
+                const int verificationScore = Negamax<NON_PV_NODE>(position, depth - reduction, ply, beta - 1, beta);
+
+                nullMoveMinPly = 0;
+
+                if (verificationScore >= beta)
+                {
+                    return nullMoveScore;
+                }
+            }
+        }
+    }
+
+    const Move previousMove = isRootNode ? Move() : searchStack[size_t(ply - 1)].currentMove;
+    const Move counterMove = previousMove.IsNull()
+                             ? Move()
+                             : counterMoves[previousMove.GetFromSquare()][previousMove.GetToSquare()];
+
+    // Along the line the last iteration expected, its move is tried first even if the table has
+    // lost it or holds another. Only PV nodes can be on that line.
+    const Move principalVariationMove = isPVNode && isFollowingPrincipalVariation &&
+                                        size_t(ply) < previousPrincipalVariation.length
+                                        ? previousPrincipalVariation.moves[size_t(ply)]
+                                        : Move();
+
+    if (!principalVariationMove.IsNull())
     {
-        return position.IsInCheck() ? -MATE_SCORE + ply : DRAW_SCORE;
+        hashMove = principalVariationMove;
     }
 
+    MovePicker movePicker(position, stackEntry.moveBuffers, hashMove, stackEntry.killerMoves, counterMove,
+                          historyTable);
+
+    stackEntry.failedQuietMoves.Clear();
+
     int bestScore = -INFINITE_SCORE;
     Move bestMove;
 
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    size_t legalMoveCount = 0;
+
+    for (Move move = movePicker.NextMove(); !move.IsNull(); move = movePicker.NextMove())
     {
-        PositionState state;
+        if (isRootNode && !IsRootMoveAllowed(move))
+        {
+            continue;
+        }
+
+        ++legalMoveCount;
+
+        const bool isQuiet = !move.IsCapture() && !move.IsPromotion();
+        const bool givesCheck = position.GivesCheck(move);
+
+        // Near the leaves, a quiet move this far down a well ordered list is very unlikely to be the
+        // one that raises alpha, so the rest of the quiet moves are not searched at all. Something
+        // must already be known to avoid mate, as the pruned moves could have been the only escape.
+        if (!isPVNode && !isInCheck && isQuiet && depth <= LATE_MOVE_PRUNING_MAX_DEPTH &&
+            bestScore > -MATE_SCORE + MAX_MATE_PLIES &&
+            legalMoveCount > LATE_MOVE_PRUNING_BASE_MOVE_COUNT + size_t(depth * depth))
+        {
+            movePicker.SkipQuietMoves();
+
+            continue;
+        }
+
+        // Near the leaves, a capture that loses more material than the depth left could plausibly
+        // win back is not searched.
+        if (!isPVNode && !isInCheck && !isQuiet && depth <= SEE_PRUNING_MAX_DEPTH &&
+            bestScore > -MATE_SCORE + MAX_MATE_PLIES &&
+            !position.SEE(move, -SEE_PRUNING_MARGIN_PER_DEPTH * depth))
+        {
+            continue;
+        }
+
+        stackEntry.currentMove = move;
+
+        if constexpr (isPVNode)
+        {
+            // Only the first move searched can be the previous line's, after which no node in the
+            // rest of the iteration is on that line.
+            isFollowingPrincipalVariation = !principalVariationMove.IsNull() && move == principalVariationMove;
+
+            searchStack[size_t(ply + 1)].principalVariation.length = 0;
+        }
+
+        const uint64_t moveStartNodes = isRootNode ? GetNodes() : 0;
+
+        position.MakeMove(move);
 
-        position.MakeMove(moves[moveIndex], state);
+        int score = 0;
 
-        const int score = -Negamax(position, depth - 1, ply + 1, -beta, -alpha);
+        // Every move after the first is expected to be worse, which a null window proves cheaply.
+        // Only a move that beats alpha after all needs the full window to find its score.
+        if (legalMoveCount == 1)
+        {
+            score = -Negamax<isPVNode ? PV_NODE : NON_PV_NODE>(position, depth - 1, ply + 1, -beta, -alpha);
+        }
+        else
+        {
+            // Late quiet moves are searched to a reduced depth first, and only searched again to
+            // full depth if they beat alpha after all.
+            int reduction = 0;
+
+            if (depth >= LATE_MOVE_REDUCTION_MIN_DEPTH && legalMoveCount > LATE_MOVE_REDUCTION_MIN_MOVE_COUNT &&
+                isQuiet && !isInCheck && !givesCheck)
+            {
+                reduction = GetLateMoveReduction(depth, legalMoveCount) - (isPVNode ? 1 : 0);
+                reduction = std::clamp(reduction, 0, depth - 2);
+            }
+
+            score = -Negamax<NON_PV_NODE>(position, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+
+            if (score > alpha && reduction > 0 && !stopped)
+            {
+                score = -Negamax<NON_PV_NODE>(position, depth - 1, ply + 1, -alpha - 1, -alpha);
+            }
+
+            if (isPVNode && score > alpha && score < beta && !stopped)
+            {
+                score = -Negamax<PV_NODE>(position, depth - 1, ply + 1, -beta, -alpha);
+            }
+        }
 
-        position.UnmakeMove(moves[moveIndex], state);
+        position.UnmakeMove(move);
 
         if (stopped)
         {
@@ -223,11 +729,12 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
         if (score > bestScore)
         {
             bestScore = score;
-            bestMove = moves[moveIndex];
+            bestMove = move;
 
-            if (ply == 0)
+            if (isRootNode)
             {
-                rootBestMove = moves[moveIndex];
+                rootBestMove = move;
+                rootBestMoveNodes = GetNodes() - moveStartNodes;
             }
         }
 
@@ -235,12 +742,34 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
         if (score > alpha)
         {
             alpha = score;
+
+            if constexpr (isPVNode)
+            {
+                UpdatePrincipalVariation(stackEntry.principalVariation, move,
+                                         searchStack[size_t(ply + 1)].principalVariation);
+            }
         }
 
         if (alpha >= beta)
         {
+            if (isQuiet)
+            {
+                UpdateQuietMoveHeuristics(position, depth, ply, move);
+            }
+
             break;
         }
+
+        if (isQuiet)
+        {
+            stackEntry.failedQuietMoves.AddMove(move);
+        }
+    }
+
+    // !EXPLAIN!
+    if (legalMoveCount == 0)
+    {
+        return isInCheck ? -MATE_SCORE + ply : DRAW_SCORE;
     }
 
     // !EXPLAIN!
@@ -249,7 +778,9 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
                                                           : UPPER_BOUND;
 
     // !EXPLAIN!
-    if (bestScore != DRAW_SCORE)
+    // A root searched without some of its moves has a score for this search alone.
+    if (bestScore != DRAW_SCORE &&
+        !(isRootNode && (excludedRootMoves.Size() > 0 || searchLimits.searchMoves.Size() > 0)))
     {
         transpositionTable.Store(hashKey, depth, ply, bestScore, boundType, bestMove);
     }
@@ -258,8 +789,18 @@ int Searcher::Negamax(Position& position, int depth, int ply, int alpha, int bet
 }
 
 // !EXPLAIN!
+template <NodeType nodeType>
 int Searcher::Quiescence(Position& position, int ply, int alpha, int beta)
 {
+    constexpr bool isPVNode = nodeType != NON_PV_NODE;
+
+    SearchStackEntry& stackEntry = searchStack[size_t(ply)];
+
+    if constexpr (isPVNode)
+    {
+        stackEntry.principalVariation.length = 0;
+    }
+
     if (ShouldStopSearch())
     {
         stopped = true;
@@ -267,12 +808,33 @@ int Searcher::Quiescence(Position& position, int ply, int alpha, int beta)
         return DRAW_SCORE;
     }
 
-    ++nodes;
+    CountNode();
+
+    const HashKey hashKey = position.GetHashKey();
+    const int originalAlpha = alpha;
+
+    Move hashMove;
+    int storedScore = 0;
+
+    // Tactical lines often transpose into each other, so even these entries are worth keeping.
+    if (transpositionTable.Probe(hashKey, QUIESCENCE_DEPTH, ply, alpha, beta, storedScore, hashMove))
+    {
+        return storedScore;
+    }
 
     const int standPatScore = Evaluate(position);
 
-    if (standPatScore >= beta || ply >= MAX_QUIESCENCE_PLY)
+    stackEntry.staticEvaluation = standPatScore;
+
+    if (ply >= MAX_QUIESCENCE_PLY)
+    {
+        return standPatScore;
+    }
+
+    if (standPatScore >= beta)
     {
+        transpositionTable.Store(hashKey, QUIESCENCE_DEPTH, ply, standPatScore, LOWER_BOUND, Move());
+
         return standPatScore;
     }
 
@@ -281,19 +843,18 @@ int Searcher::Quiescence(Position& position, int ply, int alpha, int beta)
         alpha = standPatScore;
     }
 
-    const MoveList moves = GenerateLegalMoves(position, true);
+    MovePicker movePicker(position, stackEntry.moveBuffers, hashMove);
 
     int bestScore = standPatScore;
+    Move bestMove;
 
-    for (size_t moveIndex = 0; moveIndex < moves.Size(); ++moveIndex)
+    for (Move move = movePicker.NextMove(); !move.IsNull(); move = movePicker.NextMove())
     {
-        PositionState state;
-
-        position.MakeMove(moves[moveIndex], state);
+        position.MakeMove(move);
 
-        const int score = -Quiescence(position, ply + 1, -beta, -alpha);
+        const int score = -Quiescence<nodeType>(position, ply + 1, -beta, -alpha);
 
-        position.UnmakeMove(moves[moveIndex], state);
+        position.UnmakeMove(move);
 
         if (stopped)
         {
@@ -303,6 +864,7 @@ int Searcher::Quiescence(Position& position, int ply, int alpha, int beta)
         if (score > bestScore)
         {
             bestScore = score;
+            bestMove = move;
         }
 
         if (score > alpha)
@@ -316,26 +878,25 @@ int Searcher::Quiescence(Position& position, int ply, int alpha, int beta)
         }
     }
 
+    const BoundType boundType = bestScore >= beta         ? LOWER_BOUND
+                              : bestScore > originalAlpha ? EXACT_BOUND
+                                                          : UPPER_BOUND;
+
+    transpositionTable.Store(hashKey, QUIESCENCE_DEPTH, ply, bestScore, boundType, bestMove);
+
     return bestScore;
 }
 
-int64_t Searcher::GetElapsedMilliseconds() const
+bool Searcher::IsRootMoveAllowed(Move move) const
 {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(
-               std::chrono::steady_clock::now() - startTime).count();
+    return !excludedRootMoves.Contains(move) &&
+           (searchLimits.searchMoves.Size() == 0 || searchLimits.searchMoves.Contains(move));
 }
 
-bool Searcher::ShouldStopSearch()
+int64_t Searcher::GetElapsedMilliseconds() const
 {
-    if (stopped || stopRequested.load(std::memory_order_relaxed))
-    {
-        return true;
-    }
-
-    // !EXPLAIN!
-    return timeBudgetMilliseconds != NO_TIME_LIMIT &&
-           (nodes % TIME_CHECK_NODE_INTERVAL) == 0 &&
-           GetElapsedMilliseconds() >= timeBudgetMilliseconds;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - startTime).count();
 }
 
 } // namespace Gluon
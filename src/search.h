@@ -2,7 +2,9 @@
 
 #include "move.h"
 #include "movelist.h"
+#include "movepicker.h"
 #include "position.h"
+#include "searchtimer.h"
 #include "transposition.h"
 #include "types.h"
 
@@ -10,6 +12,7 @@
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <functional>
 
 namespace Gluon {
 
@@ -18,6 +21,22 @@ constexpr int MAX_SEARCH_DEPTH = 64;
 
 constexpr int64_t NO_TIME_LIMIT = -1;
 
+constexpr uint64_t NO_NODE_LIMIT = 0;
+
+// The kind of node being searched, fixed at compile time so that the root only and PV only work is
+// left out of the non-PV nodes that make up most of the tree.
+enum NodeType : uint8_t
+{
+    ROOT_NODE,
+    PV_NODE,
+    NON_PV_NODE
+};
+
+// [ MultiPV ]
+constexpr size_t DEFAULT_MULTI_PV = 1U;
+constexpr size_t MIN_MULTI_PV = 1U;
+constexpr size_t MAX_MULTI_PV = MoveList::MAX_MOVES;
+
 // Limits on a single search, as given by the UCI "go" command.
 struct SearchLimits
 {
@@ -31,14 +50,64 @@ struct SearchLimits
 
     int movesToGo = 0;
 
+    // Counted by the main thread alone, so that a single thread searches the same tree every time.
+    uint64_t nodes = NO_NODE_LIMIT;
+
+    // Stops as soon as a mate in this many moves or fewer is found, if not zero.
+    int mate = 0;
+
+    // The root moves to choose from, or every legal move if empty.
+    MoveList searchMoves;
+
     bool infinite = false;
+
+    // Searching on the opponent's time for the move they are expected to play. The limits only
+    // apply once that move has been played.
+    bool ponder = false;
+
+    // How many of the best root moves to find a line and an exact score for.
+    size_t multiPV = DEFAULT_MULTI_PV;
+};
+
+// The line of play the search expects, best move first.
+struct PrincipalVariation
+{
+    std::array<Move, MAX_SEARCH_DEPTH> moves{};
+
+    size_t length = 0;
+};
+
+// What the search keeps for one ply of the line it is on. The entries are allocated along with the
+// searcher and reused by every node at their ply, which keeps the frame of each node small.
+struct SearchStackEntry
+{
+    MovePickerBuffers moveBuffers;
+
+    // Quiet moves searched without a cut-off, which lose history if a later quiet move causes one.
+    MoveList failedQuietMoves;
+
+    // The best line found from the node, built from the entry for the ply after it.
+    PrincipalVariation principalVariation;
+
+    // Quiet moves that caused a cut-off at this ply elsewhere in the tree.
+    KillerMoves killerMoves{};
+
+    // The move being searched, so a node can see the moves that led to it. A null move is recorded
+    // as such.
+    Move currentMove;
+
+    // Left unset by a node of the main search that is in check, where it means nothing.
+    int staticEvaluation = 0;
 };
 
 // Best move found so far, reported after each completed iteration and returned once the search ends.
+// With MultiPV, each line is reported on its own and the best line is returned.
 struct SearchResult
 {
     Move bestMove;
 
+    PrincipalVariation principalVariation;
+
     int score = 0;
 
     int depth = 0;
@@ -48,55 +117,137 @@ struct SearchResult
     int64_t timeMilliseconds = 0;
 
     int hashFull = 0;
+
+    // Where this line ranks among the MultiPV lines, from 1 for the best.
+    size_t multiPV = 1;
 };
 
-using SearchReportCallback = void (*)(const SearchResult& result);
+using SearchReportCallback = std::function<void(const SearchResult& result)>;
 
+// Searches a position on a single thread. Several searchers can share one transposition table,
+// which is how the thread pool runs a Lazy SMP search.
 class Searcher
 {
 public:
     // [ Constructors ]
-    Searcher();
+    Searcher(TranspositionTable& sharedTranspositionTable, size_t searchThreadIndex = 0);
 
     // [ Public methods ]
     SearchResult Run(Position& position, const SearchLimits& limits,
-                     SearchReportCallback report = nullptr);
+                     const SearchReportCallback& report = nullptr);
 
     // Asks a running search to finish as soon as it can. May be called from another thread.
     void RequestStop();
 
-    void ResizeTranspositionTable(size_t megabytes);
+    // Run leaves the stop request alone, so this must be called before the search is started.
+    void ClearStopRequest();
+
+    // Starts the clock the time limits are measured on, or holds it back until PonderHit when
+    // pondering. Must be called before the search is started.
+    void ResetClock(bool pondering);
+
+    // The expected move was played, so the time limits start to apply. May be called from another
+    // thread.
+    void PonderHit();
+
+    // Run counts on from where the last search left off, so this must be called before the search
+    // is started for the count to cover that search alone.
+    void ClearNodes();
+
+    // Forgets the move ordering learnt in earlier searches, as when a new game starts.
+    void ClearHeuristics();
 
-    void ClearTranspositionTable();
+    // Nodes searched so far by this searcher. May be called from another thread.
+    inline uint64_t GetNodes() const
+    {
+        return nodes.load(std::memory_order_relaxed);
+    }
 
 private:
     // [ Private methods ]
-    static MoveList OrderMoves(const MoveList& moves, Move hashMove);
+    int AspirationSearch(Position& position, int depth, int previousScore);
 
+    // Rewards a quiet move that caused a cut-off, so it is tried earlier elsewhere in the tree, and
+    // penalises the quiet moves searched before it that did not.
+    void UpdateQuietMoveHeuristics(const Position& position, int depth, int ply, Move move);
+
+    // Keeps what was learnt in the last search as a hint for this one, without letting it outweigh
+    // what this search learns.
+    void AgeHeuristics();
+
+    template <NodeType nodeType>
     int Negamax(Position& position, int depth, int ply, int alpha, int beta);
 
+    template <NodeType nodeType>
     int Quiescence(Position& position, int ply, int alpha, int beta);
 
     int64_t GetElapsedMilliseconds() const;
 
-    bool ShouldStopSearch();
+    // Running out of time is signalled through the stop flag by the stop timer, so only the node
+    // limit has to be checked here.
+    inline bool ShouldStopSearch() const
+    {
+        return stopped || stopRequested.load(std::memory_order_relaxed) ||
+               (searchLimits.nodes != NO_NODE_LIMIT && GetNodes() >= searchLimits.nodes);
+    }
+
+    // Whether the current line may play the root move: it must be one of the search moves, if any
+    // were given, and must not already have a MultiPV line of its own.
+    bool IsRootMoveAllowed(Move move) const;
+
+    // Only the searching thread writes the counter, so it does not need an atomic increment.
+    inline void CountNode()
+    {
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
 
     // [ Data members ]
     std::atomic<bool> stopRequested;
 
     bool stopped;
 
-    uint64_t nodes;
+    std::atomic<uint64_t> nodes;
 
     Move rootBestMove;
 
+    // Nodes spent searching the root best move in the current iteration.
+    uint64_t rootBestMoveNodes;
+
+    // One entry for every ply a node can be searched at. Quiescence search stops well before the
+    // last ply the main search can reach.
+    std::array<SearchStackEntry, MAX_SEARCH_DEPTH + 1> searchStack;
+
+    // The line found by the last completed iteration, whose moves are searched first in the next.
+    PrincipalVariation previousPrincipalVariation;
+
+    // Set while the moves made from the root are all those of the previous line.
+    bool isFollowingPrincipalVariation;
+
+    // Root moves that already have a MultiPV line of their own in this iteration.
+    MoveList excludedRootMoves;
+
+    HistoryTable historyTable;
+
+    CounterMoveTable counterMoves;
+
+    // Null moves are not tried before this ply, which keeps them out of a verification search.
+    int nullMoveMinPly;
+
     SearchLimits searchLimits;
 
-    int64_t timeBudgetMilliseconds;
+    int64_t softTimeLimitMilliseconds;
+
+    int64_t hardTimeLimitMilliseconds;
+
+    // Sets stopRequested once the hard limit has passed, and keeps the clock the limits are
+    // measured on.
+    SearchTimer stopTimer;
 
     std::chrono::steady_clock::time_point startTime;
 
-    TranspositionTable transpositionTable;
+    TranspositionTable& transpositionTable;
+
+    size_t threadIndex;
 };
 
 } // namespace Gluon
@@ -0,0 +1,118 @@
+#include "searchtimer.h"
+
+namespace Gluon {
+
+// [ Constructors ]
+SearchTimer::SearchTimer()
+    : cancelled(false),
+      pondering(false),
+      clockStartTime(std::chrono::steady_clock::now()) {}
+
+SearchTimer::~SearchTimer()
+{
+    Cancel();
+}
+
+// [ Public methods ]
+void SearchTimer::ResetClock(bool ponder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pondering = ponder;
+    clockStartTime = std::chrono::steady_clock::now();
+}
+
+void SearchTimer::Start(std::atomic<bool>& stopFlag, int64_t limitMilliseconds)
+{
+    Cancel();
+
+    cancelled = false;
+
+    timerThread = std::thread([this, &stopFlag, limitMilliseconds]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        condition.wait(lock, [this]() { return cancelled || !pondering; });
+
+        const auto deadline = clockStartTime + std::chrono::milliseconds(limitMilliseconds);
+
+        if (!condition.wait_until(lock, deadline, [this]() { return cancelled; }))
+        {
+            stopFlag.store(true, std::memory_order_relaxed);
+        }
+    });
+}
+
+void SearchTimer::Cancel()
+{
+    if (!timerThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        cancelled = true;
+    }
+
+    condition.notify_all();
+
+    timerThread.join();
+}
+
+void SearchTimer::PonderHit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!pondering)
+        {
+            return;
+        }
+
+        pondering = false;
+        clockStartTime = std::chrono::steady_clock::now();
+    }
+
+    condition.notify_all();
+}
+
+void SearchTimer::Notify()
+{
+    {
+        // Taken so that a waiter cannot miss the notification between checking and waiting.
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+
+    condition.notify_all();
+}
+
+void SearchTimer::WaitWhilePondering(const std::atomic<bool>& stopFlag)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    condition.wait(lock, [this, &stopFlag]() { return !pondering || stopFlag.load(std::memory_order_relaxed); });
+}
+
+bool SearchTimer::IsPondering()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return pondering;
+}
+
+int64_t SearchTimer::GetClockMilliseconds()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pondering)
+    {
+        return 0;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - clockStartTime).count();
+}
+
+} // namespace Gluon
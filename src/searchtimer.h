@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace Gluon {
+
+// Sets a stop flag from a thread of its own once a time limit passes, so that the search only has
+// to read the flag rather than the clock. While pondering the clock is held back, and only starts
+// once the expected move has been played.
+class SearchTimer
+{
+public:
+    // [ Constructors ]
+    SearchTimer();
+
+    ~SearchTimer();
+
+    // [ Public methods ]
+    // Restarts the clock, or holds it back until PonderHit when pondering. Must be called before
+    // the search is started.
+    void ResetClock(bool pondering);
+
+    // Sets the flag once the limit has passed on the clock, unless cancelled first. A timer that is
+    // still running is cancelled before the new one starts.
+    void Start(std::atomic<bool>& stopFlag, int64_t limitMilliseconds);
+
+    // Returns once the timer thread has finished, which it does straight away if the limit has not
+    // passed yet.
+    void Cancel();
+
+    // Starts the clock of a search that was pondering. May be called from another thread.
+    void PonderHit();
+
+    // Wakes anything waiting on the timer to look at the stop flag again. May be called from
+    // another thread.
+    void Notify();
+
+    // Returns once the search is no longer pondering or the stop flag is set.
+    void WaitWhilePondering(const std::atomic<bool>& stopFlag);
+
+    bool IsPondering();
+
+    // Time on the clock since it started, which is none while pondering.
+    int64_t GetClockMilliseconds();
+
+private:
+    // [ Data members ]
+    std::thread timerThread;
+
+    std::mutex mutex;
+
+    // Signalled when the timer is cancelled, the ponder move is played or a stop is requested.
+    std::condition_variable condition;
+
+    bool cancelled;
+
+    bool pondering;
+
+    std::chrono::steady_clock::time_point clockStartTime;
+};
+
+} // namespace Gluon
@@ -0,0 +1,258 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Gluon {
+
+// [ Constructors ]
+SearchThread::SearchThread(TranspositionTable& transpositionTable, size_t threadIndex)
+    : searcher(transpositionTable, threadIndex),
+      isSearching(false),
+      isQuitting(false),
+      thread(&SearchThread::IdleLoop, this) {}
+
+SearchThread::~SearchThread()
+{
+    WaitUntilIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        isQuitting = true;
+    }
+
+    condition.notify_all();
+
+    thread.join();
+}
+
+// [ Public methods ]
+void SearchThread::Start(std::function<void(Searcher& searcher)> searchJob)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        job = std::move(searchJob);
+        isSearching = true;
+    }
+
+    condition.notify_all();
+}
+
+void SearchThread::WaitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    condition.wait(lock, [this]() { return !isSearching; });
+}
+
+// [ Private methods ]
+void SearchThread::IdleLoop()
+{
+    while (true)
+    {
+        std::function<void(Searcher& searcher)> searchJob;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            condition.wait(lock, [this]() { return isSearching || isQuitting; });
+
+            if (isQuitting)
+            {
+                return;
+            }
+
+            searchJob = std::move(job);
+        }
+
+        searchJob(searcher);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            isSearching = false;
+        }
+
+        condition.notify_all();
+    }
+}
+
+// [ Constructors ]
+ThreadPool::ThreadPool()
+{
+    SetThreadCount(DEFAULT_THREAD_COUNT);
+}
+
+// [ Public methods ]
+void ThreadPool::StartSearch(const Position& position, const SearchLimits& limits,
+                             const SearchReportCallback& report,
+                             const SearchCompletionCallback& onCompletion)
+{
+    WaitForSearch();
+
+    rootPosition = position;
+    rootLimits = limits;
+
+    transpositionTable.NewSearch();
+
+    // Cleared here rather than by each searcher, so that an early report from the main thread
+    // never adds in a count left over from the last search by a helper that has not started yet.
+    // Stop requests are cleared here too, so that a stop sent as soon as this returns is not lost.
+    for (const std::unique_ptr<SearchThread>& searchThread : threads)
+    {
+        searchThread->GetSearcher().ClearNodes();
+        searchThread->GetSearcher().ClearStopRequest();
+    }
+
+    threads[0]->GetSearcher().ResetClock(limits.ponder);
+
+    // The main thread alone keeps to the limits; the helpers search until they are told to stop,
+    // choosing from the same root moves.
+    for (size_t threadIndex = 1; threadIndex < threads.size(); ++threadIndex)
+    {
+        threads[threadIndex]->Start([this, threadIndex](Searcher& helperSearcher)
+        {
+            SearchLimits helperLimits;
+            helperLimits.infinite = true;
+            helperLimits.searchMoves = rootLimits.searchMoves;
+
+            Position helperPosition = rootPosition;
+
+            helperResults[threadIndex - 1U] = helperSearcher.Run(helperPosition, helperLimits);
+        });
+    }
+
+    threads[0]->Start([this, report, onCompletion](Searcher& mainSearcher)
+    {
+        lastResult = RunMainSearch(mainSearcher, report);
+
+        if (onCompletion)
+        {
+            onCompletion(lastResult);
+        }
+    });
+}
+
+void ThreadPool::WaitForSearch()
+{
+    threads[0]->WaitUntilIdle();
+}
+
+SearchResult ThreadPool::Run(const Position& position, const SearchLimits& limits,
+                             const SearchReportCallback& report)
+{
+    StartSearch(position, limits, report);
+
+    WaitForSearch();
+
+    return lastResult;
+}
+
+void ThreadPool::RequestStop()
+{
+    for (const std::unique_ptr<SearchThread>& searchThread : threads)
+    {
+        searchThread->GetSearcher().RequestStop();
+    }
+}
+
+void ThreadPool::PonderHit()
+{
+    threads[0]->GetSearcher().PonderHit();
+}
+
+void ThreadPool::SetThreadCount(size_t threadCount)
+{
+    const size_t clampedThreadCount = std::clamp(threadCount, MIN_THREAD_COUNT, MAX_THREAD_COUNT);
+
+    threads.clear();
+
+    for (size_t threadIndex = 0; threadIndex < clampedThreadCount; ++threadIndex)
+    {
+        threads.push_back(std::make_unique<SearchThread>(transpositionTable, threadIndex));
+    }
+
+    helperResults.assign(clampedThreadCount - 1U, SearchResult());
+}
+
+void ThreadPool::ResizeTranspositionTable(size_t megabytes)
+{
+    transpositionTable.Resize(megabytes);
+}
+
+void ThreadPool::ClearTranspositionTable()
+{
+    transpositionTable.Clear();
+}
+
+void ThreadPool::ClearHeuristics()
+{
+    for (const std::unique_ptr<SearchThread>& searchThread : threads)
+    {
+        searchThread->GetSearcher().ClearHeuristics();
+    }
+}
+
+uint64_t ThreadPool::GetTotalNodes() const
+{
+    uint64_t totalNodes = 0;
+
+    for (const std::unique_ptr<SearchThread>& searchThread : threads)
+    {
+        totalNodes += searchThread->GetSearcher().GetNodes();
+    }
+
+    return totalNodes;
+}
+
+// [ Private methods ]
+SearchResult ThreadPool::RunMainSearch(Searcher& mainSearcher, const SearchReportCallback& report)
+{
+    // Reports carry the node count of every thread, not just the main one.
+    SearchReportCallback totalNodesReport = nullptr;
+
+    if (report)
+    {
+        totalNodesReport = [this, &report](const SearchResult& mainResult)
+        {
+            SearchResult totalResult = mainResult;
+            totalResult.nodes = GetTotalNodes();
+
+            report(totalResult);
+        };
+    }
+
+    Position mainPosition = rootPosition;
+
+    SearchResult result = mainSearcher.Run(mainPosition, rootLimits, totalNodesReport);
+
+    for (size_t threadIndex = 1; threadIndex < threads.size(); ++threadIndex)
+    {
+        threads[threadIndex]->GetSearcher().RequestStop();
+    }
+
+    for (size_t threadIndex = 1; threadIndex < threads.size(); ++threadIndex)
+    {
+        threads[threadIndex]->WaitUntilIdle();
+    }
+
+    // A helper that completed a deeper iteration than the main thread has the better move.
+    for (const SearchResult& helperResult : helperResults)
+    {
+        if (helperResult.depth > result.depth && !helperResult.bestMove.IsNull())
+        {
+            result.bestMove = helperResult.bestMove;
+            result.principalVariation = helperResult.principalVariation;
+            result.score = helperResult.score;
+            result.depth = helperResult.depth;
+        }
+    }
+
+    result.nodes = GetTotalNodes();
+
+    return result;
+}
+
+} // namespace Gluon
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "position.h"
+#include "search.h"
+#include "transposition.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Gluon {
+
+// [ Thread counts ]
+constexpr size_t DEFAULT_THREAD_COUNT = 1U;
+constexpr size_t MIN_THREAD_COUNT = 1U;
+constexpr size_t MAX_THREAD_COUNT = 256U;
+
+using SearchCompletionCallback = std::function<void(const SearchResult& result)>;
+
+// A thread that is created once and parked between searches, together with the searcher it runs,
+// so neither the thread nor the searcher's move ordering tables are rebuilt for every search.
+class SearchThread
+{
+public:
+    // [ Constructors ]
+    SearchThread(TranspositionTable& transpositionTable, size_t threadIndex);
+
+    ~SearchThread();
+
+    // [ Public methods ]
+    // Wakes the thread to run the job on its searcher. The thread must be idle.
+    void Start(std::function<void(Searcher& searcher)> job);
+
+    // Returns once the thread has finished its job and parked again.
+    void WaitUntilIdle();
+
+    inline Searcher& GetSearcher()
+    {
+        return searcher;
+    }
+
+private:
+    // [ Private methods ]
+    void IdleLoop();
+
+    // [ Data members ]
+    Searcher searcher;
+
+    std::mutex mutex;
+
+    // Signalled both when a job is handed over and when it is finished.
+    std::condition_variable condition;
+
+    std::function<void(Searcher& searcher)> job;
+
+    bool isSearching;
+
+    bool isQuitting;
+
+    // Last, so that the thread only starts once everything it uses has been constructed.
+    std::thread thread;
+};
+
+// Runs a Lazy SMP search: every searcher searches the same position, and they help each other
+// only through the transposition table they share.
+class ThreadPool
+{
+public:
+    // [ Constructors ]
+    ThreadPool();
+
+    // [ Public methods ]
+    // Wakes the threads and returns straight away. The main thread keeps to the limits, the helpers
+    // search until it has finished, and the completion callback is then called on the main thread
+    // with the result. Any stop request left over from the last search is cleared first.
+    void StartSearch(const Position& position, const SearchLimits& limits,
+                     const SearchReportCallback& report = nullptr,
+                     const SearchCompletionCallback& onCompletion = nullptr);
+
+    // Returns once the main thread has finished, by which time every helper has stopped too.
+    void WaitForSearch();
+
+    // Starts a search and waits for its result.
+    SearchResult Run(const Position& position, const SearchLimits& limits,
+                     const SearchReportCallback& report = nullptr);
+
+    // Asks every searcher to stop. May be called from another thread.
+    void RequestStop();
+
+    // Tells a pondering search that the expected move was played. May be called from another thread.
+    void PonderHit();
+
+    // The threads are recreated, so there must be no search running.
+    void SetThreadCount(size_t threadCount);
+
+    void ResizeTranspositionTable(size_t megabytes);
+
+    void ClearTranspositionTable();
+
+    // Clears the move ordering tables each searcher keeps from one search to the next.
+    void ClearHeuristics();
+
+    // Nodes searched so far by all of the threads together. May be called from another thread.
+    uint64_t GetTotalNodes() const;
+
+private:
+    // [ Private methods ]
+    // Runs on the main thread: searches, stops the helpers, and picks the result to play.
+    SearchResult RunMainSearch(Searcher& mainSearcher, const SearchReportCallback& report);
+
+    // [ Data members ]
+    TranspositionTable transpositionTable;
+
+    std::vector<std::unique_ptr<SearchThread>> threads;
+
+    // Copied in when a search is started, for every thread to take its own copy of the position.
+    Position rootPosition;
+
+    SearchLimits rootLimits;
+
+    std::vector<SearchResult> helperResults;
+
+    SearchResult lastResult;
+};
+
+} // namespace Gluon
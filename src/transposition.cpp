@@ -37,8 +37,13 @@ static int StoredScoreToScore(int storedScore, int ply)
     return storedScore;
 }
 
+// [ Replacement ]
+// Each search an entry has sat unused counts against it like this many plies of depth.
+static constexpr int AGE_DEPTH_PENALTY = 4;
+
 // [ Constructors ]
 TranspositionTable::TranspositionTable()
+    : generation(0U)
 {
     Resize(DEFAULT_HASH_SIZE_MEGABYTES);
 }
@@ -48,89 +53,165 @@ void TranspositionTable::Resize(size_t megabytes)
 {
     const size_t clampedMegabytes = std::clamp(megabytes, MIN_HASH_SIZE_MEGABYTES,
                                                MAX_HASH_SIZE_MEGABYTES);
-    const size_t requestedEntryCount = clampedMegabytes * BYTES_PER_MEGABYTE /
-                                       sizeof(TranspositionEntry);
+    const size_t requestedBucketCount = clampedMegabytes * BYTES_PER_MEGABYTE /
+                                        sizeof(TranspositionBucket);
 
     // !EXPLAIN!
-    size_t entryCount = 1U;
-    while (entryCount * 2U <= requestedEntryCount)
+    size_t bucketCount = 1U;
+    while (bucketCount * 2U <= requestedBucketCount)
     {
-        entryCount *= 2U;
+        bucketCount *= 2U;
     }
 
-    entries.assign(entryCount, TranspositionEntry());
+    // Atomics cannot be copied, so the buckets are built in place by a new vector.
+    buckets = std::vector<TranspositionBucket>(bucketCount);
+    generation = 0U;
 }
 
 void TranspositionTable::Clear()
 {
-    std::fill(entries.begin(), entries.end(), TranspositionEntry());
+    for (TranspositionBucket& bucket : buckets)
+    {
+        for (PackedTranspositionEntry& packedEntry : bucket.entries)
+        {
+            packedEntry.store(0ULL, std::memory_order_relaxed);
+        }
+    }
+
+    generation = 0U;
+}
+
+void TranspositionTable::NewSearch()
+{
+    generation = uint8_t((generation + 1U) % GENERATION_CYCLE);
 }
 
 bool TranspositionTable::Probe(HashKey key, int depth, int ply, int alpha, int beta, int& score,
                                Move& hashMove) const
 {
-    const TranspositionEntry& entry = entries[GetIndex(key)];
+    const TranspositionBucket& bucket = buckets[GetIndex(key)];
+    const uint16_t keyFragment = GetKeyFragment(key);
 
-    if (entry.boundType == NO_BOUND || entry.key != key)
+    for (const PackedTranspositionEntry& packedEntry : bucket.entries)
     {
-        return false;
-    }
+        const TranspositionEntry entry = UnpackEntry(packedEntry.load(std::memory_order_relaxed));
+
+        if (entry.GetBoundType() == NO_BOUND || entry.keyFragment != keyFragment)
+        {
+            continue;
+        }
 
-    hashMove = entry.move;
+        hashMove = entry.move;
 
-    if (int(entry.depth) < depth)
-    {
-        return false;
-    }
+        if (int(entry.depth) < depth)
+        {
+            return false;
+        }
 
-    const int storedScore = StoredScoreToScore(int(entry.score), ply);
+        const int storedScore = StoredScoreToScore(int(entry.score), ply);
 
-    // !EXPLAIN!
-    if (entry.boundType == EXACT_BOUND ||
-        (entry.boundType == LOWER_BOUND && storedScore >= beta) ||
-        (entry.boundType == UPPER_BOUND && storedScore <= alpha))
-    {
-        score = storedScore;
+        // !EXPLAIN!
+        if (entry.GetBoundType() == EXACT_BOUND ||
+            (entry.GetBoundType() == LOWER_BOUND && storedScore >= beta) ||
+            (entry.GetBoundType() == UPPER_BOUND && storedScore <= alpha))
+        {
+            score = storedScore;
+
+            return true;
+        }
 
-        return true;
+        return false;
     }
 
     return false;
 }
 
+// The position's own entry is reused if it is in the bucket, and otherwise an empty entry, and
+// otherwise the entry whose depth is worth least once its age is taken off.
 void TranspositionTable::Store(HashKey key, int depth, int ply, int score, BoundType boundType,
                                Move move)
 {
-    TranspositionEntry& entry = entries[GetIndex(key)];
+    TranspositionBucket& bucket = buckets[GetIndex(key)];
+    const uint16_t keyFragment = GetKeyFragment(key);
+
+    PackedTranspositionEntry* replacedPackedEntry = &bucket.entries[0];
+    TranspositionEntry entry = UnpackEntry(bucket.entries[0].load(std::memory_order_relaxed));
+    int replacedWorth = INFINITE_SCORE;
 
-    // Keep the deeper search of a position that is already stored.
-    if (entry.key == key && int(entry.depth) > depth && boundType != EXACT_BOUND)
+    for (PackedTranspositionEntry& packedEntry : bucket.entries)
+    {
+        const TranspositionEntry candidateEntry = UnpackEntry(packedEntry.load(std::memory_order_relaxed));
+
+        if (candidateEntry.GetBoundType() == NO_BOUND || candidateEntry.keyFragment == keyFragment)
+        {
+            replacedPackedEntry = &packedEntry;
+            entry = candidateEntry;
+
+            break;
+        }
+
+        const int worth = int(candidateEntry.depth) - AGE_DEPTH_PENALTY * GetAge(candidateEntry);
+
+        if (worth < replacedWorth)
+        {
+            replacedPackedEntry = &packedEntry;
+            entry = candidateEntry;
+            replacedWorth = worth;
+        }
+    }
+
+    const bool isSamePosition = entry.GetBoundType() != NO_BOUND && entry.keyFragment == keyFragment;
+
+    // Quiescence entries are cheap to find again and there are many of them, so they only take the
+    // place of each other, of empty entries and of entries left by earlier searches.
+    if (depth == QUIESCENCE_DEPTH && entry.GetBoundType() != NO_BOUND && int(entry.depth) > depth &&
+        GetAge(entry) == 0)
+    {
+        return;
+    }
+
+    // Keep the deeper search of a position that is already stored, as long as it is from this search.
+    if (isSamePosition && int(entry.depth) > depth && boundType != EXACT_BOUND && GetAge(entry) == 0)
     {
         return;
     }
 
-    entry.key = key;
-    entry.move = move;
+    // A search that found no move still leaves the old move the best guess for ordering.
+    if (!move.IsNull() || !isSamePosition)
+    {
+        entry.move = move;
+    }
+
+    entry.keyFragment = keyFragment;
     entry.score = int16_t(ScoreToStoredScore(score, ply));
     entry.depth = uint8_t(depth);
-    entry.boundType = boundType;
+    entry.generationAndBound = uint8_t((generation << GENERATION_SHIFT) | boundType);
+
+    replacedPackedEntry->store(PackEntry(entry), std::memory_order_relaxed);
 }
 
+// Only entries written by the current search count, as the rest are free to be replaced.
 int TranspositionTable::GetHashFull() const
 {
-    const size_t sampleSize = std::min(HASH_FULL_SAMPLE_SIZE, entries.size());
+    const size_t sampleBucketCount = std::min(HASH_FULL_SAMPLE_SIZE / ENTRIES_PER_BUCKET, buckets.size());
+    const size_t sampleSize = sampleBucketCount * ENTRIES_PER_BUCKET;
 
     size_t usedEntryCount = 0;
 
-    for (size_t entryIndex = 0; entryIndex < sampleSize; ++entryIndex)
+    for (size_t bucketIndex = 0; bucketIndex < sampleBucketCount; ++bucketIndex)
     {
-        if (entries[entryIndex].boundType != NO_BOUND)
+        for (const PackedTranspositionEntry& packedEntry : buckets[bucketIndex].entries)
         {
-            ++usedEntryCount;
+            const TranspositionEntry entry = UnpackEntry(packedEntry.load(std::memory_order_relaxed));
+
+            if (entry.GetBoundType() != NO_BOUND && GetAge(entry) == 0)
+            {
+                ++usedEntryCount;
+            }
         }
     }
 
     return sampleSize > 0 ? int(usedEntryCount * HASH_FULL_SAMPLE_SIZE / sampleSize) : 0;
 }
 
-} // namespace Gluon
+} // namespace Gluon
\ No newline at end of file
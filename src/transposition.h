@@ -3,6 +3,9 @@
 #include "move.h"
 #include "types.h"
 
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cstdint>
 #include <vector>
 
@@ -18,6 +21,11 @@ constexpr size_t MAX_HASH_SIZE_MEGABYTES = 1024U;
 // Entries sampled to estimate how full the table is, which is reported per mille.
 constexpr size_t HASH_FULL_SAMPLE_SIZE = 1000U;
 
+constexpr size_t CACHE_LINE_SIZE = 64U;
+
+// The depth quiescence search stores its entries at, which is below that of any main search entry.
+constexpr int QUIESCENCE_DEPTH = 0;
+
 // What a stored score says about the true score of a position.
 enum BoundType : uint8_t
 {
@@ -29,9 +37,20 @@ enum BoundType : uint8_t
     NUM_BOUND_TYPES
 };
 
+// [ Entry packing ]
+constexpr uint8_t BOUND_TYPE_MASK = 0x3U;
+
+constexpr uint8_t GENERATION_SHIFT = 2U;
+
+// The generation wraps around within the bits left over by the bound type.
+constexpr uint8_t GENERATION_CYCLE = 1U << (8U - GENERATION_SHIFT);
+
+// Only the top bits of the key are kept, as the bottom bits already chose the bucket.
+constexpr uint8_t KEY_FRAGMENT_SHIFT = 48U;
+
 struct TranspositionEntry
 {
-    HashKey key = 0ULL;
+    uint16_t keyFragment = 0U;
 
     Move move;
 
@@ -39,9 +58,49 @@ struct TranspositionEntry
 
     uint8_t depth = 0U;
 
-    BoundType boundType = NO_BOUND;
+    // The search that last wrote the entry and what kind of bound it holds, packed into one byte.
+    uint8_t generationAndBound = 0U;
+
+    inline BoundType GetBoundType() const
+    {
+        return BoundType(generationAndBound & BOUND_TYPE_MASK);
+    }
+
+    inline uint8_t GetGeneration() const
+    {
+        return uint8_t(generationAndBound >> GENERATION_SHIFT);
+    }
 };
 
+// An entry is stored as a single word, so that a thread reading it while another thread writes it
+// sees either the old entry or the new one, never a mix of the two. This needs no locks.
+using PackedTranspositionEntry = std::atomic<uint64_t>;
+
+static_assert(sizeof(TranspositionEntry) == sizeof(uint64_t));
+static_assert(PackedTranspositionEntry::is_always_lock_free);
+
+inline uint64_t PackEntry(const TranspositionEntry& entry)
+{
+    return std::bit_cast<uint64_t>(entry);
+}
+
+inline TranspositionEntry UnpackEntry(uint64_t packedEntry)
+{
+    return std::bit_cast<TranspositionEntry>(packedEntry);
+}
+
+constexpr size_t ENTRIES_PER_BUCKET = CACHE_LINE_SIZE / sizeof(PackedTranspositionEntry);
+
+// All the entries a key can be stored in, filling one cache line so a probe costs a single miss.
+struct alignas(CACHE_LINE_SIZE) TranspositionBucket
+{
+    std::array<PackedTranspositionEntry, ENTRIES_PER_BUCKET> entries{};
+};
+
+static_assert(sizeof(TranspositionBucket) == CACHE_LINE_SIZE);
+
+// Safe to probe and store from any number of threads at once. Two threads storing to the same
+// bucket at once may lose one of the stores, which costs no more than a collision would.
 class TranspositionTable
 {
 public:
@@ -53,6 +112,9 @@ public:
 
     void Clear();
 
+    // Ages every entry by one search, so entries from earlier searches are the first replaced.
+    void NewSearch();
+
     // Gives the stored move for move ordering, and returns true when the stored score can be used
     // in place of searching the position again.
     bool Probe(HashKey key, int depth, int ply, int alpha, int beta, int& score, Move& hashMove) const;
@@ -66,11 +128,24 @@ private:
     // !EXPLAIN!
     inline size_t GetIndex(HashKey key) const
     {
-        return size_t(key) & (entries.size() - 1U);
+        return size_t(key) & (buckets.size() - 1U);
+    }
+
+    static inline uint16_t GetKeyFragment(HashKey key)
+    {
+        return uint16_t(key >> KEY_FRAGMENT_SHIFT);
+    }
+
+    // How many searches ago the entry was written.
+    inline int GetAge(const TranspositionEntry& entry) const
+    {
+        return (GENERATION_CYCLE + generation - entry.GetGeneration()) % GENERATION_CYCLE;
     }
 
     // [ Data members ]
-    std::vector<TranspositionEntry> entries;
+    std::vector<TranspositionBucket> buckets;
+
+    uint8_t generation;
 };
 
 } // namespace Gluon
@@ -47,6 +47,21 @@ enum PieceType : uint8_t
     NUM_PIECE_TYPES = 6U
 };
 
+// For tables with an entry per piece type.
+constexpr size_t PieceTypeToIndex(PieceType pieceType)
+{
+    switch (pieceType)
+    {
+        case PAWN:   return 0;
+        case KNIGHT: return 1;
+        case BISHOP: return 2;
+        case ROOK:   return 3;
+        case QUEEN:  return 4;
+        case KING:   return 5;
+        default:     return 0;
+    }
+}
+
 // Piece type
 
 constexpr uint8_t WHITE_PIECE_COLOUR_MASK = 0x80U;
@@ -3,6 +3,8 @@
 #include "benchmark.h"
 #include "engine.h"
 #include "evaluation.h"
+#include "movegenerator.h"
+#include "threadpool.h"
 #include "transposition.h"
 
 #include <iostream>
@@ -61,16 +63,37 @@ static void HandleGoCommand(Engine& engine, std::istringstream& commandStream)
 
     std::string token;
 
+    bool isReadingSearchMoves = false;
+
     while (commandStream >> token)
     {
-        if      (token == "depth")     { commandStream >> limits.depth; }
-        else if (token == "movetime")  { commandStream >> limits.moveTimeMilliseconds; }
-        else if (token == "wtime")     { commandStream >> limits.remainingTimeMilliseconds[WHITE]; }
-        else if (token == "btime")     { commandStream >> limits.remainingTimeMilliseconds[BLACK]; }
-        else if (token == "winc")      { commandStream >> limits.incrementMilliseconds[WHITE]; }
-        else if (token == "binc")      { commandStream >> limits.incrementMilliseconds[BLACK]; }
-        else if (token == "movestogo") { commandStream >> limits.movesToGo; }
-        else if (token == "infinite")  { limits.infinite = true; }
+        // The search moves run on until a token that is not a move.
+        if (isReadingSearchMoves)
+        {
+            const Move move = ParseLegalMove(engine.GetPosition(), token);
+
+            if (!move.IsNull())
+            {
+                limits.searchMoves.AddMove(move);
+
+                continue;
+            }
+
+            isReadingSearchMoves = false;
+        }
+
+        if      (token == "depth")       { commandStream >> limits.depth; }
+        else if (token == "movetime")    { commandStream >> limits.moveTimeMilliseconds; }
+        else if (token == "wtime")       { commandStream >> limits.remainingTimeMilliseconds[WHITE]; }
+        else if (token == "btime")       { commandStream >> limits.remainingTimeMilliseconds[BLACK]; }
+        else if (token == "winc")        { commandStream >> limits.incrementMilliseconds[WHITE]; }
+        else if (token == "binc")        { commandStream >> limits.incrementMilliseconds[BLACK]; }
+        else if (token == "movestogo")   { commandStream >> limits.movesToGo; }
+        else if (token == "nodes")       { commandStream >> limits.nodes; }
+        else if (token == "mate")        { commandStream >> limits.mate; }
+        else if (token == "infinite")    { limits.infinite = true; }
+        else if (token == "ponder")      { limits.ponder = true; }
+        else if (token == "searchmoves") { isReadingSearchMoves = true; }
     }
 
     engine.StartSearch(limits);
@@ -106,6 +129,28 @@ static void HandleSetOptionCommand(Engine& engine, std::istringstream& commandSt
             engine.SetHashSize(megabytes);
         }
     }
+    else if (optionName == "Threads")
+    {
+        std::istringstream optionValueStream(optionValue);
+
+        size_t threadCount = 0;
+
+        if (optionValueStream >> threadCount)
+        {
+            engine.SetThreadCount(threadCount);
+        }
+    }
+    else if (optionName == "MultiPV")
+    {
+        std::istringstream optionValueStream(optionValue);
+
+        size_t multiPV = 0;
+
+        if (optionValueStream >> multiPV)
+        {
+            engine.SetMultiPV(multiPV);
+        }
+    }
     else if (optionName == "Clear Hash")
     {
         engine.ClearHash();
@@ -156,7 +201,14 @@ void RunLoop(Engine& engine)
                       "option name Hash type spin default " + std::to_string(DEFAULT_HASH_SIZE_MEGABYTES) +
                       " min " + std::to_string(MIN_HASH_SIZE_MEGABYTES) +
                       " max " + std::to_string(MAX_HASH_SIZE_MEGABYTES) + '\n' +
+                      "option name Threads type spin default " + std::to_string(DEFAULT_THREAD_COUNT) +
+                      " min " + std::to_string(MIN_THREAD_COUNT) +
+                      " max " + std::to_string(MAX_THREAD_COUNT) + '\n' +
+                      "option name MultiPV type spin default " + std::to_string(DEFAULT_MULTI_PV) +
+                      " min " + std::to_string(MIN_MULTI_PV) +
+                      " max " + std::to_string(MAX_MULTI_PV) + '\n' +
                       "option name Clear Hash type button" + '\n' +
+                      "option name Ponder type check default false" + '\n' +
                       "uciok");
         }
         else if (command == "setoption")
@@ -185,6 +237,10 @@ void RunLoop(Engine& engine)
         {
             engine.StopSearch();
         }
+        else if (command == "ponderhit")
+        {
+            engine.PonderHit();
+        }
         else if (command == "d")
         {
             PrintLine(engine.GetPosition().ToString());
@@ -201,6 +257,22 @@ void RunLoop(Engine& engine)
         {
             RunEvaluationTest();
         }
+        else if (command == "seetest")
+        {
+            RunStaticExchangeTest();
+        }
+        else if (command == "checktest")
+        {
+            RunGivesCheckTest();
+        }
+        else if (command == "legaltest")
+        {
+            RunMoveLegalityTest();
+        }
+        else if (command == "tttest")
+        {
+            RunTranspositionTableTest();
+        }
         else if (command == "quit")
         {
             break;
@@ -216,7 +288,8 @@ void PrintSearchInfo(const SearchResult& result)
 
     std::ostringstream infoStream;
 
-    infoStream << "info depth " << result.depth;
+    infoStream << "info depth " << result.depth
+               << " multipv " << result.multiPV;
 
     if (IsMateScore(result.score))
     {
@@ -231,15 +304,28 @@ void PrintSearchInfo(const SearchResult& result)
                << " nps " << nodesPerSecond
                << " time " << result.timeMilliseconds
                << " hashfull " << result.hashFull
-               << " pv " << result.bestMove.ToString();
+               << " pv";
+
+    for (size_t moveIndex = 0; moveIndex < result.principalVariation.length; ++moveIndex)
+    {
+        infoStream << ' ' << result.principalVariation.moves[moveIndex].ToString();
+    }
 
     PrintLine(infoStream.str());
 }
 
 void PrintBestMove(const SearchResult& result)
 {
-    PrintLine("bestmove " + (result.bestMove.IsNull() ? std::string("0000")
-                                                      : result.bestMove.ToString()));
+    std::string bestMoveString = "bestmove " + (result.bestMove.IsNull() ? std::string("0000")
+                                                                         : result.bestMove.ToString());
+
+    // The reply the line expects is the one to ponder on.
+    if (result.principalVariation.length >= 2 && result.principalVariation.moves[0] == result.bestMove)
+    {
+        bestMoveString += " ponder " + result.principalVariation.moves[1].ToString();
+    }
+
+    PrintLine(bestMoveString);
 }
 
 } // namespace Gluon::UCI